@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "accuracy.h"
+
+static const char* const ycbcr_names[3] = {"Y", "Cb", "Cr"};
+static const char* const rgb_names[3] = {"R", "G", "B"};
+static const char* const bin_names[ERROR_BINS] = {"0", "1", "2", "3", "4-7", "8-15", "16-31", "32+"};
+
+
+size_t frame_format_size(const image_t* image, frame_format_t format){
+    switch (format) {
+        case FRAME_YCBCR:
+            return YCBCR_FRAME_SIZE(image);
+        case FRAME_YCBCR420:
+            return DOWNSAMPLED_FRAME_SIZE(image);
+        case FRAME_YCBCR422:
+            return SUBSAMPLED_FRAME_SIZE(image, 2, 1);
+        case FRAME_YCBCR411:
+            return SUBSAMPLED_FRAME_SIZE(image, 4, 1);
+        case FRAME_RGBA:
+            return (size_t) image->stride * image->height * sizeof(uint32);
+        default:
+            return PLANAR_FRAME_SIZE(image);
+    }
+}
+
+
+frame_format_t subsampling_format(subsampling_t subsampling){
+    static const frame_format_t formats[SUBSAMPLING_MODES] = {FRAME_YCBCR420, FRAME_YCBCR422, FRAME_YCBCR411, FRAME_YCBCR, FRAME_YCBCR420};
+    return formats[subsampling];
+}
+
+
+// Sampling block of the format, 1 x 1 for the full resolution ones
+static const subsampling_mode_t* format_mode(frame_format_t format){
+    switch (format) {
+        case FRAME_YCBCR:
+        case FRAME_RGBA:
+            return &subsampling_modes[SUBSAMPLING_444];
+        case FRAME_YCBCR422:
+            return &subsampling_modes[SUBSAMPLING_422];
+        case FRAME_YCBCR411:
+            return &subsampling_modes[SUBSAMPLING_411];
+        default:
+            return &subsampling_modes[SUBSAMPLING_420];
+    }
+}
+
+
+// Chroma planes have one sample per sampling block
+static uint32 plane_width(const image_t* image, frame_format_t format, int plane){
+    uint32 horizontal = plane > 0 ? format_mode(format)->horizontal : 1;
+    return (image->width + horizontal - 1) / horizontal;
+}
+
+static uint32 plane_height(const image_t* image, frame_format_t format, int plane){
+    uint32 vertical = plane > 0 ? format_mode(format)->vertical : 1;
+    return (image->height + vertical - 1) / vertical;
+}
+
+
+// Samples of one row of a plane, in place when they are contiguous, gathered into buffer when not
+static const uint8* plane_row(const uint8* frame, const image_t* image, frame_format_t format, int plane, uint32 row, uint8* buffer){
+    uint32 width = plane_width(image, format, plane);
+    const uint8* samples;
+    size_t step;
+
+    switch (format) {
+        case FRAME_YCBCR:
+            samples = frame + (size_t) row * image->stride * 3 + plane;
+            step = 3;
+            break;
+        case FRAME_RGBA:
+            samples = frame + (size_t) row * image->stride * 4 + plane;
+            step = 4;
+            break;
+        case FRAME_YCBCR420:
+        case FRAME_YCBCR422:
+        case FRAME_YCBCR411: {
+            // sampling blocks of horizontal x vertical Y samples, row by row, then Cb and Cr
+            const subsampling_mode_t* mode = format_mode(format);
+            uint32 block_y = mode->horizontal * mode->vertical;
+            size_t row_size = SUBSAMPLED_ROW_SIZE(image, mode->horizontal, mode->vertical);
+            if (plane == 0) {
+                const uint8* pixel = frame + (row / mode->vertical) * row_size + (row % mode->vertical) * mode->horizontal;
+                for (uint32 col = 0; col < width; ++col) {
+                    buffer[col] = pixel[(col / mode->horizontal) * (block_y + 2) + col % mode->horizontal];
+                }
+                return buffer;
+            }
+            samples = frame + row * row_size + block_y + plane - 1;
+            step = block_y + 2;
+            break;
+        }
+        default: {
+            planes_t planes = frame_planes((uint8*) frame, image, format == FRAME_I420 ? LAYOUT_I420 : LAYOUT_NV12);
+            if (plane == 0) {
+                return planes.y + (size_t) row * image->stride;
+            }
+            if (format == FRAME_I420) {
+                return (plane == 1 ? planes.cb : planes.cr) + (size_t) row * CHROMA_STRIDE(image);
+            }
+            samples = planes.cb + (size_t) row * CHROMA_STRIDE(image) * 2 + plane - 1;
+            step = 2;
+        }
+    }
+
+    for (uint32 col = 0; col < width; ++col) {
+        buffer[col] = samples[col * step];
+    }
+    return buffer;
+}
+
+
+void compare_frames(const void* reference, frame_format_t reference_format, const void* frame, frame_format_t format,
+                    const image_t* image, frame_error_t* error){
+    uint8* reference_buffer = malloc(image->width);
+    uint8* buffer = malloc(image->width);
+
+    memset(error, 0, sizeof(frame_error_t));
+    error->plane_names = (format == FRAME_RGBA) ? rgb_names : ycbcr_names;
+
+    for (int plane = 0; plane < 3; ++plane) {
+        for (uint32 row = 0; row < plane_height(image, format, plane); ++row) {
+            kernels->compare(plane_row(reference, image, reference_format, plane, row, reference_buffer),
+                             plane_row(frame, image, format, plane, row, buffer), plane_width(image, format, plane), &error->planes[plane]);
+        }
+    }
+
+    free(buffer);
+    free(reference_buffer);
+}
+
+
+double plane_psnr(const sample_error_t* plane){
+    if (plane->sum_squares == 0) {
+        return INFINITY;
+    }
+    return 10.0 * log10(255.0 * 255.0 * (double) plane->samples / (double) plane->sum_squares);
+}
+
+
+uint8 frame_max_error(const frame_error_t* error){
+    uint8 max_error = 0;
+    for (int plane = 0; plane < 3; ++plane) {
+        max_error = error->planes[plane].max_error > max_error ? error->planes[plane].max_error : max_error;
+    }
+    return max_error;
+}
+
+
+void print_frame_error(FILE* output, const frame_error_t* error){
+    fprintf(output, "[o] PSNR");
+    for (int plane = 0; plane < 3; ++plane) {
+        fprintf(output, "%s %s \033[1;36m%.2f\033[0m dB (max error %u)", plane ? "," : "", error->plane_names[plane],
+                plane_psnr(&error->planes[plane]), error->planes[plane].max_error);
+    }
+    fprintf(output, "\n");
+
+    for (int plane = 0; plane < 3; ++plane) {
+        const sample_error_t* samples = &error->planes[plane];
+        fprintf(output, "    %-2s error", error->plane_names[plane]);
+        for (int bin = 0; bin < ERROR_BINS; ++bin) {
+            fprintf(output, "  %s: %.2f%%", bin_names[bin], samples->samples ? 100.0 * samples->histogram[bin] / samples->samples : 0.0);
+        }
+        fprintf(output, "\n");
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef COLOR_SPACE_CONVERSION_ACCURACY_H
+#define COLOR_SPACE_CONVERSION_ACCURACY_H
+
+#include <stdio.h>
+#include "conversion.h"
+
+/**
+ * Accuracy of a converted frame against a reference, per plane: PSNR, largest absolute error and a
+ * histogram of the absolute errors. The two frames may have different layouts of the same planes, a
+ * planar I420 frame can be checked against a 4:2:0 macro-pixel reference, say. Contiguous plane rows
+ * are compared in place, interleaved ones are gathered a row at a time, and the comparison itself runs
+ * on the compare kernel of the kernel table.
+ */
+typedef enum { FRAME_YCBCR, FRAME_YCBCR420, FRAME_I420, FRAME_NV12, FRAME_RGBA, FRAME_YCBCR422, FRAME_YCBCR411 } frame_format_t;
+
+typedef struct frame_error{
+    const char* const* plane_names;     // Y, Cb, Cr or R, G, B
+    sample_error_t planes[3];
+} frame_error_t;
+
+// Bytes of a frame of the format, for the output buffers of the kernels
+size_t frame_format_size(const image_t* image, frame_format_t format);
+
+// Format of the frames of a subsampling mode, co-sited 4:2:0 has the macro-pixels of the box one
+frame_format_t subsampling_format(subsampling_t subsampling);
+
+void compare_frames(const void* reference, frame_format_t reference_format, const void* frame, frame_format_t format,
+                    const image_t* image, frame_error_t* error);
+
+// PSNR in dB, INFINITY for identical planes
+double plane_psnr(const sample_error_t* plane);
+
+// Largest max_error of the three planes
+uint8 frame_max_error(const frame_error_t* error);
+
+// PSNR and max error per plane on one line, the error histogram in percent on the next
+void print_frame_error(FILE* output, const frame_error_t* error);
+
+#endif //COLOR_SPACE_CONVERSION_ACCURACY_H
@@ -0,0 +1,248 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "conversion.h"
+#include "thread_pool.h"
+#include "frame_pool.h"
+#include "autotune.h"
+
+// Each worker converts for at least this long per candidate and at least TUNING_FRAMES frames, after one
+// warm-up frame that also faults its frames in
+#define TUNING_SECONDS 0.05
+#define TUNING_FRAMES 3
+// More workers have to convert this much more per second to win, anything less is noise or memory bound
+#define WORKER_GAIN 1.1
+#define WISDOM_LINE 512
+
+typedef struct tuning_run{
+    const uint32* raster;
+    const image_t* image;
+    subsampling_t subsampling;
+    bool two_stage;
+    pthread_barrier_t start;
+} tuning_run_t;
+
+typedef struct tuning_worker{
+    tuning_run_t* run;
+    double rate;                // frames per second
+} tuning_worker_t;
+
+
+static double elapsed_seconds(const struct timeval* start, const struct timeval* stop){
+    return (double) ((stop->tv_sec - start->tv_sec) * 1000000 + stop->tv_usec - start->tv_usec) / 1e6;
+}
+
+
+// Model name of the first CPU, the implementer and part numbers on ARM cores that have no model name
+static void cpu_model(char* model, size_t size){
+    FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
+    char line[256], implementer[32] = "", part[32] = "";
+
+    snprintf(model, size, "unknown");
+    while (cpuinfo != NULL && fgets(line, sizeof(line), cpuinfo) != NULL) {
+        char* value = strchr(line, ':');
+        if (value == NULL) {
+            continue;
+        }
+        value += 1 + strspn(value + 1, " \t");
+        value[strcspn(value, "\n")] = '\0';
+        if (strncmp(line, "model name", 10) == 0) {
+            snprintf(model, size, "%s", value);
+            implementer[0] = '\0';
+            break;
+        }
+        if (strncmp(line, "CPU implementer", 15) == 0 && implementer[0] == '\0') {
+            snprintf(implementer, sizeof(implementer), "%s", value);
+        } else if (strncmp(line, "CPU part", 8) == 0 && part[0] == '\0') {
+            snprintf(part, sizeof(part), "%s", value);
+        }
+    }
+    if (cpuinfo != NULL) {
+        fclose(cpuinfo);
+    }
+    if (implementer[0] != '\0') {
+        snprintf(model, size, "ARM %s:%s", implementer, part);
+    }
+    // tabs separate the fields of a wisdom line
+    for (char* c = model; *c != '\0'; ++c) {
+        *c = (*c == '\t') ? ' ' : *c;
+    }
+}
+
+
+// "<cpu model>\t<cpus>\t<width>x<height>\t<subsampling>\t", what a wisdom line has to start with to apply
+static size_t wisdom_key(char* key, size_t size, const image_t* image, subsampling_t subsampling, const cpu_set_t* cpus){
+    char model[256];
+    cpu_model(model, sizeof(model));
+    snprintf(key, size, "%s\t%d\t%ux%u\t%s\t", model, CPU_COUNT(cpus), image->width, image->height, subsampling_modes[subsampling].name);
+    return strlen(key);
+}
+
+
+bool load_wisdom(const char* wisdom_file, const image_t* image, subsampling_t subsampling, const cpu_set_t* cpus, tuning_t* tuning){
+    const kernel_table_t* tables[ISA_KERNELS];
+    uint32 n_tables = supported_kernels(tables);
+    char key[WISDOM_LINE], line[WISDOM_LINE], isa[16], path[16];
+    size_t key_length = wisdom_key(key, sizeof(key), image, subsampling, cpus);
+    FILE* file = fopen(wisdom_file, "r");
+    bool found = false;
+
+    while (!found && file != NULL && fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, key, key_length) != 0 || sscanf(line + key_length, "%15s %15s %d", isa, path, &tuning->n_workers) != 3 ||
+            tuning->n_workers <= 0) {
+            continue;
+        }
+        // kernels the CPU does not offer here (another hypervisor, say) are measured again
+        for (uint32 table = 0; table < n_tables; ++table) {
+            if (strcmp(tables[table][0].name, isa) == 0) {
+                tuning->isa_kernels = tables[table];
+                tuning->two_stage = strcmp(path, "two-stage") == 0;
+                found = true;
+            }
+        }
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+    return found;
+}
+
+
+// Rewrites wisdom_file with the line of key replaced, through a new file so concurrent runs never read half of one
+static void save_wisdom(const char* wisdom_file, const char* key, subsampling_t subsampling, const tuning_t* tuning){
+    char line[WISDOM_LINE];
+    char* temporary = malloc(strlen(wisdom_file) + 16);
+    sprintf(temporary, "%s.%d", wisdom_file, (int) getpid());
+    FILE* output = fopen(temporary, "w");
+    FILE* input = fopen(wisdom_file, "r");
+
+    if (output == NULL) {
+        printf("[-] \033[0;31mCould not write %s, the tuning is not kept\033[0m\n", temporary);
+    } else {
+        if (input == NULL) {
+            fprintf(output, "# cpu model\tcpus\tframe\tsubsampling\tkernels\t4:2:0 path\tworkers\n");
+        }
+        while (input != NULL && fgets(line, sizeof(line), input) != NULL) {
+            if (strncmp(line, key, strlen(key)) != 0) {
+                fputs(line, output);
+            }
+        }
+        fprintf(output, "%s%s\t%s\t%d\n", key, tuning->isa_kernels[0].name,
+                subsampling != SUBSAMPLING_420 ? "-" : tuning->two_stage ? "two-stage" : "fused", tuning->n_workers);
+        if (fclose(output) != 0 || rename(temporary, wisdom_file) != 0) {
+            printf("[-] \033[0;31mCould not write %s, the tuning is not kept\033[0m\n", wisdom_file);
+            remove(temporary);
+        }
+    }
+    if (input != NULL) {
+        fclose(input);
+    }
+    free(temporary);
+}
+
+
+// Converts the frame into frames of its own for TUNING_SECONDS, starting when every worker is ready
+static void* tuning_worker(void* args){
+    tuning_worker_t* worker = (tuning_worker_t*) args;
+    tuning_run_t* run = worker->run;
+    struct timeval stop, start;
+    int frames = 0;
+    uint8* ycbcr = subsampling_via_ycbcr(run->subsampling, run->two_stage) ? frame_alloc(YCBCR_FRAME_SIZE(run->image)) : NULL;
+    uint8* subsampled_ycbcr = frame_alloc(subsampled_frame_size(run->image, run->subsampling));
+
+    if ((ycbcr == NULL && subsampling_via_ycbcr(run->subsampling, run->two_stage)) || subsampled_ycbcr == NULL) {
+        printf("[-] \033[0;31mCould not allocate the tuning frames\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+
+    convert_rgb_to_subsampled_into(run->raster, ycbcr, subsampled_ycbcr, run->image, run->subsampling, run->two_stage);
+    pthread_barrier_wait(&run->start);
+    // timed here rather than by the caller, which may not get a CPU back until the workers are done
+    gettimeofday(&start, NULL);
+    do {
+        convert_rgb_to_subsampled_into(run->raster, ycbcr, subsampled_ycbcr, run->image, run->subsampling, run->two_stage);
+        gettimeofday(&stop, NULL);
+    } while (++frames < TUNING_FRAMES || elapsed_seconds(&start, &stop) < TUNING_SECONDS);
+    worker->rate = frames / elapsed_seconds(&start, &stop);
+
+    free(subsampled_ycbcr);
+    free(ycbcr);
+    return NULL;
+}
+
+
+// Frames per second of n_workers pinned like the batch workers, all converting at once
+static double frames_per_second(tuning_run_t* run, int n_workers, const cpu_set_t* cpus){
+    pthread_t* threads = malloc(sizeof(pthread_t) * n_workers);
+    tuning_worker_t* workers = malloc(sizeof(tuning_worker_t) * n_workers);
+    double rate = 0;
+    int cpu = -1;
+
+    if (threads == NULL || workers == NULL) {
+        printf("[-] \033[0;31mCould not allocate %d tuning workers\033[0m\n", n_workers);
+        exit(EXIT_FAILURE);
+    }
+    pthread_barrier_init(&run->start, NULL, n_workers);
+    for (int id = 0; id < n_workers; ++id) {
+        workers[id].run = run;
+        // the others would wait at the barrier for it forever
+        if (thread_create_pinned(&threads[id], &cpu, cpus, tuning_worker, &workers[id]) != 0) {
+            printf("[-] \033[0;31mCould not start tuning worker %d\033[0m\n", id);
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int id = 0; id < n_workers; ++id) {
+        pthread_join(threads[id], NULL);
+        rate += workers[id].rate;
+    }
+    pthread_barrier_destroy(&run->start);
+    free(workers);
+    free(threads);
+    return rate;
+}
+
+
+void autotune(const char* wisdom_file, const uint32* raster, const image_t* image, subsampling_t subsampling, const cpu_set_t* cpus,
+              tuning_t* tuning){
+    const kernel_table_t* tables[ISA_KERNELS];
+    uint32 n_tables = supported_kernels(tables);
+    tuning_run_t run = {.raster = raster, .image = image, .subsampling = subsampling, .two_stage = false};
+    int max_workers = CPU_COUNT(cpus) > 0 ? CPU_COUNT(cpus) : 1;
+    char key[WISDOM_LINE];
+    double best = 0;
+
+    // only box 4:2:0 has two paths, the other modes always convert to 4:4:4 first or not at all
+    for (uint32 table = 0; table < n_tables; ++table) {
+        select_isa_kernels(tables[table]);
+        for (int two_stage = 0; two_stage <= (subsampling == SUBSAMPLING_420); ++two_stage) {
+            run.two_stage = two_stage;
+            double rate = frames_per_second(&run, 1, cpus);
+            printf("[o] Tuning \033[1;36m%s\033[0m kernels%s: \033[1;36m%.1f\033[0m frames/s\n", kernels->name,
+                   subsampling != SUBSAMPLING_420 ? "" : two_stage ? ", two-stage 4:2:0" : ", fused 4:2:0", rate);
+            if (rate > best) {
+                best = rate;
+                tuning->isa_kernels = tables[table];
+                tuning->two_stage = two_stage;
+            }
+        }
+    }
+
+    select_isa_kernels(tuning->isa_kernels);
+    run.two_stage = tuning->two_stage;
+    tuning->n_workers = 1;
+    for (int n_workers = 2; n_workers <= max_workers; n_workers = (n_workers * 2 > max_workers && n_workers < max_workers) ? max_workers : n_workers * 2) {
+        double rate = frames_per_second(&run, n_workers, cpus);
+        printf("[o] Tuning \033[1;36m%2d\033[0m workers: \033[1;36m%.1f\033[0m frames/s\n", n_workers, rate);
+        if (rate > best * WORKER_GAIN) {
+            best = rate;
+            tuning->n_workers = n_workers;
+        }
+    }
+
+    wisdom_key(key, sizeof(key), image, subsampling, cpus);
+    save_wisdom(wisdom_file, key, subsampling, tuning);
+}
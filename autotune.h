@@ -0,0 +1,31 @@
+#ifndef COLOR_SPACE_CONVERSION_AUTOTUNE_H
+#define COLOR_SPACE_CONVERSION_AUTOTUNE_H
+
+#include <sched.h>
+#include <tiffio.h>
+#include "conversion.h"
+
+/**
+ * Per-machine choice of how the batch converter runs: the instruction set of the kernels, the fused
+ * 4:2:0 kernel or conversion followed by downsampling, and the number of frames converted at once.
+ * The winners are kept in a wisdom file, a text file of one line per CPU model, CPU count, frame size
+ * and subsampling mode, so only the first run of a kind on a machine pays for the measurements.
+ */
+typedef struct tuning{
+    const kernel_table_t* isa_kernels;  // tables of the instruction set, for select_isa_kernels()
+    bool two_stage;                     // box 4:2:0 through a 4:4:4 frame instead of the fused kernel
+    int n_workers;
+} tuning_t;
+
+// The tuning wisdom_file has for this machine, frame size and mode; false when there is none yet
+bool load_wisdom(const char* wisdom_file, const image_t* image, subsampling_t subsampling, const cpu_set_t* cpus, tuning_t* tuning);
+
+/**
+ * Converts raster with every instruction set and 4:2:0 path on one thread, then with the fastest one
+ * on 1, 2, 4, ... up to every CPU of `cpus` at once, and adds the winners to wisdom_file. Only the
+ * conversion is timed, decoding and writing the frames are left out. Leaves the winning kernels selected.
+ */
+void autotune(const char* wisdom_file, const uint32* raster, const image_t* image, subsampling_t subsampling, const cpu_set_t* cpus,
+              tuning_t* tuning);
+
+#endif //COLOR_SPACE_CONVERSION_AUTOTUNE_H
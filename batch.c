@@ -0,0 +1,333 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <glob.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "conversion.h"
+#include "thread_pool.h"
+#include "frame_pool.h"
+#include "autotune.h"
+#include "profile.h"
+#include "batch.h"
+
+typedef struct file_list{
+    char** paths;
+    uint32 n_paths;
+    uint32 capacity;
+} file_list_t;
+
+typedef struct batch{
+    file_list_t* inputs;
+    char** outputs;             // output name of every input, without the .tiff extension
+    subsampling_t subsampling;
+    bool two_stage;             // box 4:2:0 through a 4:4:4 frame instead of the fused kernel
+    uint32 next;                // next input to claim, atomic
+    uint32 started;             // workers started, atomic, numbers their profiles
+    uint32 failed;              // atomic
+    uint64 pixels;              // atomic
+} batch_t;
+
+
+static void add_path(file_list_t* list, const char* path){
+    if (list->n_paths == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->paths = realloc(list->paths, sizeof(char*) * list->capacity);
+    }
+    list->paths[list->n_paths++] = strdup(path);
+}
+
+
+// Natural order, so frame2 comes before frame10
+static int compare_paths(const void* a, const void* b){
+    return strverscmp(*(char* const*) a, *(char* const*) b);
+}
+
+
+static bool is_tiff(const char* name){
+    const char* extension = strrchr(name, '.');
+    return extension != NULL && (strcasecmp(extension, ".tif") == 0 || strcasecmp(extension, ".tiff") == 0);
+}
+
+
+static void add_directory(file_list_t* list, const char* path){
+    DIR* directory = opendir(path);
+    struct dirent* entry;
+    uint32 first = list->n_paths;
+
+    if (directory == NULL) {
+        printf("[-] \033[0;31mCould not open directory %s\033[0m\n", path);
+        exit(EXIT_FAILURE);
+    }
+    while ((entry = readdir(directory)) != NULL) {
+        if (entry->d_name[0] != '.' && is_tiff(entry->d_name)) {
+            char* file = malloc(strlen(path) + strlen(entry->d_name) + 2);
+            sprintf(file, "%s/%s", path, entry->d_name);
+            add_path(list, file);
+            free(file);
+        }
+    }
+    closedir(directory);
+    qsort(list->paths + first, list->n_paths - first, sizeof(char*), compare_paths);
+}
+
+
+static void add_list_file(file_list_t* list, const char* path){
+    FILE* file = fopen(path, "r");
+    char* line = NULL;
+    size_t size = 0;
+    ssize_t length;
+
+    if (file == NULL) {
+        printf("[-] \033[0;31mCould not open list %s\033[0m\n", path);
+        exit(EXIT_FAILURE);
+    }
+    // one path per line, blank lines and # comments are skipped
+    while ((length = getline(&line, &size, file)) != -1) {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+        if (length > 0 && line[0] != '#') {
+            add_path(list, line);
+        }
+    }
+    free(line);
+    fclose(file);
+}
+
+
+static void add_pattern(file_list_t* list, const char* pattern){
+    glob_t matches;
+    uint32 first = list->n_paths;
+
+    if (glob(pattern, 0, NULL, &matches) != 0) {
+        printf("[-] \033[0;31mNo input matches %s\033[0m\n", pattern);
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < matches.gl_pathc; ++i) {
+        add_path(list, matches.gl_pathv[i]);
+    }
+    globfree(&matches);
+    qsort(list->paths + first, list->n_paths - first, sizeof(char*), compare_paths);
+}
+
+
+// output_dir/<file name without extension>, two inputs of the same name would overwrite each other
+static char** output_names(const file_list_t* inputs, const char* output_dir){
+    char** outputs = malloc(sizeof(char*) * inputs->n_paths);
+    char** sorted = malloc(sizeof(char*) * inputs->n_paths);
+
+    for (uint32 i = 0; i < inputs->n_paths; ++i) {
+        const char* name = strrchr(inputs->paths[i], '/') ? strrchr(inputs->paths[i], '/') + 1 : inputs->paths[i];
+        const char* extension = strrchr(name, '.');
+        int length = extension ? (int) (extension - name) : (int) strlen(name);
+
+        outputs[i] = malloc(strlen(output_dir) + length + 2);
+        sprintf(outputs[i], "%s/%.*s", output_dir, length, name);
+        sorted[i] = outputs[i];
+    }
+
+    qsort(sorted, inputs->n_paths, sizeof(char*), compare_paths);
+    for (uint32 i = 1; i < inputs->n_paths; ++i) {
+        if (strcmp(sorted[i - 1], sorted[i]) == 0) {
+            printf("[-] \033[0;31mMore than one input would be written to %s.tiff\033[0m\n", sorted[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    free(sorted);
+    return outputs;
+}
+
+
+// Grows a reused frame to size bytes, the contents are not kept
+static uint8* reserve_frame(uint8* frame, size_t* capacity, size_t size, const image_t* image){
+    if (size <= *capacity) {
+        return frame;
+    }
+    free(frame);
+    *capacity = size;
+    frame = frame_alloc(size);
+    if (frame == NULL) {
+        printf("[-] \033[0;31mCould not allocate a %ux%u frame\033[0m\n", image->width, image->height);
+        exit(EXIT_FAILURE);
+    }
+    return frame;
+}
+
+
+/**
+ * Kernels, 4:2:0 path and worker count for the frame size of the first input, from the wisdom file or
+ * measured on that frame when it has none yet. An explicit worker count stays.
+ */
+static void tune_batch(const char* first_input, const char* wisdom_file, const cpu_set_t* cpus, batch_t* batch, int* n_workers){
+    mapped_file_t mapping = {NULL, 0};
+    uint32* raster = NULL;
+    size_t raster_capacity = 0;
+    const uint32* input;
+    tuning_t tuning;
+    image_t image;
+
+    if (!read_tiff_size(first_input, &image)) {
+        printf("[-] \033[0;31mCould not read %s, running untuned\033[0m\n", first_input);
+        return;
+    }
+    bool cached = load_wisdom(wisdom_file, &image, batch->subsampling, cpus, &tuning);
+    if (!cached) {
+        printf("[+] Tuning for \033[1;36m%ux%u\033[0m frames on this machine into %s\n", image.width, image.height, wisdom_file);
+        input = map_tiff_raster(first_input, &image, &mapping);
+        if (input == NULL) {
+            if (!read_tiff_raster(first_input, &image, &raster, &raster_capacity)) {
+                printf("[-] \033[0;31mCould not read %s, running untuned\033[0m\n", first_input);
+                return;
+            }
+            input = raster;
+        }
+        autotune(wisdom_file, input, &image, batch->subsampling, cpus, &tuning);
+        unmap_tiff(&mapping);
+        free(raster);
+    }
+
+    select_isa_kernels(tuning.isa_kernels);
+    batch->two_stage = tuning.two_stage;
+    if (*n_workers <= 0) {
+        *n_workers = tuning.n_workers;
+    }
+    printf("[o] %s \033[1;36m%s\033[0m kernels%s, \033[1;36m%d\033[0m workers for %ux%u\n", cached ? "Wisdom has" : "Tuned to", kernels->name,
+           batch->subsampling != SUBSAMPLING_420 ? "" : tuning.two_stage ? ", two-stage 4:2:0" : ", fused 4:2:0", tuning.n_workers, image.width, image.height);
+}
+
+
+static void* batch_worker(void* args){
+    batch_t* batch = (batch_t*) args;
+    uint32* raster = NULL;
+    size_t raster_capacity = 0;
+    mapped_file_t mapping = {NULL, 0};
+    const uint32* input;
+    uint8* ycbcr = NULL;
+    uint8* subsampled_ycbcr = NULL;
+    size_t ycbcr_capacity = 0, frame_capacity = 0;
+    uint32 index;
+    image_t image;
+    char name[32];
+
+    snprintf(name, sizeof(name), "worker %u", __atomic_fetch_add(&batch->started, 1, __ATOMIC_RELAXED));
+    profiler_t* profiler = profiler_create(name);
+
+    // the raster and the frames are reused for every frame of the same size or smaller
+    while ((index = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->inputs->n_paths) {
+        profile_start(profiler);
+        // uncompressed frames skip the raster, the kernels read them from the page cache
+        input = map_tiff_raster(batch->inputs->paths[index], &image, &mapping);
+        if (input == NULL) {
+            if (!read_tiff_raster(batch->inputs->paths[index], &image, &raster, &raster_capacity)) {
+                printf("[-] \033[0;31mCould not read %s\033[0m\n", batch->inputs->paths[index]);
+                __atomic_fetch_add(&batch->failed, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+            input = raster;
+        }
+        profile_stage(profiler, PROFILE_READ);
+
+        subsampled_ycbcr = reserve_frame(subsampled_ycbcr, &frame_capacity, subsampled_frame_size(&image, batch->subsampling), &image);
+        // same as convert_rgb_to_subsampled_into(), with the two stages profiled apart
+        if (subsampling_via_ycbcr(batch->subsampling, batch->two_stage)) {
+            ycbcr = reserve_frame(ycbcr, &ycbcr_capacity, YCBCR_FRAME_SIZE(&image), &image);
+            kernels->convert(input, ycbcr, &image, image.height);
+            profile_stage(profiler, PROFILE_CONVERT);
+            subsample_ycbcr_simd_into(ycbcr, subsampled_ycbcr, &image, batch->subsampling);
+            profile_stage(profiler, PROFILE_DOWNSAMPLE);
+        } else {
+            convert_rgb_to_subsampled_into(input, NULL, subsampled_ycbcr, &image, batch->subsampling, batch->two_stage);
+            profile_stage(profiler, PROFILE_CONVERT);
+        }
+        unmap_tiff(&mapping);
+        write_tiff_image(subsampled_ycbcr, batch->outputs[index], &image, batch->subsampling);
+        profile_stage(profiler, PROFILE_WRITE);
+        profile_frame(profiler, batch->inputs->paths[index]);
+        __atomic_fetch_add(&batch->pixels, (uint64) image.width * image.height, __ATOMIC_RELAXED);
+    }
+
+    profiler_destroy(profiler);
+    free(subsampled_ycbcr);
+    free(ycbcr);
+    free(raster);
+    return NULL;
+}
+
+
+uint32 convert_tiff_batch(char** inputs, int n_inputs, char* output_dir, int n_workers, const cpu_set_t* cpus, subsampling_t subsampling,
+                          const char* wisdom_file){
+    file_list_t files = {NULL, 0, 0};
+    batch_t batch = {&files, NULL, subsampling, false, 0, 0, 0, 0};
+    struct timeval stop, start;
+    struct stat info;
+    int cpu = -1;
+
+    for (int i = 0; i < n_inputs; ++i) {
+        if (inputs[i][0] == '@') {
+            add_list_file(&files, inputs[i] + 1);
+        } else if (stat(inputs[i], &info) == 0 && S_ISDIR(info.st_mode)) {
+            add_directory(&files, inputs[i]);
+        } else {
+            add_pattern(&files, inputs[i]);
+        }
+    }
+    if (files.n_paths == 0) {
+        printf("[-] \033[0;31mNo frames to convert\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+    if (mkdir(output_dir, 0755) != 0 && errno != EEXIST) {
+        printf("[-] \033[0;31mCould not create %s\033[0m\n", output_dir);
+        exit(EXIT_FAILURE);
+    }
+    batch.outputs = output_names(&files, output_dir);
+    if (wisdom_file != NULL) {
+        tune_batch(files.paths[0], wisdom_file, cpus, &batch, &n_workers);
+    }
+
+    if (n_workers <= 0) {
+        n_workers = CPU_COUNT(cpus) > 0 ? CPU_COUNT(cpus) : 1;
+    }
+    if ((uint32) n_workers > files.n_paths) {
+        n_workers = (int) files.n_paths;
+    }
+    pthread_t* workers = malloc(sizeof(pthread_t) * n_workers);
+    if (workers == NULL) {
+        printf("[-] \033[0;31mCould not allocate %d workers\033[0m\n", n_workers);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("[+] Converting \033[1;36m%u\033[0m frames to %s with \033[1;36m%d\033[0m workers, %s subsampling\n", files.n_paths, output_dir, n_workers,
+           subsampling_modes[subsampling].name);
+    gettimeofday(&start, NULL);
+    // workers are pinned round-robin to the CPUs of the set, like the thread pool
+    for (int id = 0; id < n_workers; ++id) {
+        if (thread_create_pinned(&workers[id], &cpu, cpus, batch_worker, &batch) != 0) {
+            printf("[-] \033[0;31mCould not start batch worker %d\033[0m\n", id);
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int id = 0; id < n_workers; ++id) {
+        pthread_join(workers[id], NULL);
+    }
+    gettimeofday(&stop, NULL);
+
+    double seconds = (double) ((stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec) / 1e6;
+    uint32 converted = files.n_paths - batch.failed;
+    printf("[o] Converted \033[1;36m%u\033[0m frames (%u failed) in \033[1;36m%.3f\033[0m s, \033[1;36m%.1f\033[0m frames/s, %.1f Mpx/s\n",
+           converted, batch.failed, seconds, converted / seconds, batch.pixels / seconds / 1e6);
+
+    for (uint32 i = 0; i < files.n_paths; ++i) {
+        free(files.paths[i]);
+        free(batch.outputs[i]);
+    }
+    free(files.paths);
+    free(batch.outputs);
+    free(workers);
+    return batch.failed;
+}
@@ -0,0 +1,21 @@
+#ifndef COLOR_SPACE_CONVERSION_BATCH_H
+#define COLOR_SPACE_CONVERSION_BATCH_H
+
+#include <sched.h>
+#include <tiffio.h>
+#include "conversion.h"
+
+/**
+ * Batch conversion of whole frame sequences with file-level parallelism. Every input is a TIFF file, a
+ * directory (all of its .tif/.tiff files), a glob pattern or @list, a text file of paths one per line.
+ * Each worker decodes, converts to the subsampling mode and encodes one frame at a time, so at most
+ * n_workers frames are in flight. Frames are claimed in input order, with directories and globs in natural (frame1, frame2,
+ * ..., frame10) order, and frame.tif is always written to output_dir/frame.tiff.
+ * n_workers <= 0 runs one worker per CPU of `cpus`. With a wisdom_file the kernels, the 4:2:0 path and
+ * the worker count are the ones autotune() picked for this machine and the size of the first frame,
+ * measured and added to the file on the first run. Returns the number of frames that failed.
+ */
+uint32 convert_tiff_batch(char** inputs, int n_inputs, char* output_dir, int n_workers, const cpu_set_t* cpus, subsampling_t subsampling,
+                          const char* wisdom_file);
+
+#endif //COLOR_SPACE_CONVERSION_BATCH_H
@@ -0,0 +1,739 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "conversion.h"
+#include "thread_pool.h"
+#include "frame_pool.h"
+#include "accuracy.h"
+#ifdef ARCH_X86
+#include <x86intrin.h>
+#endif
+
+/**
+ * Benchmark of every kernel variant on synthetic frames, independent of TIFF I/O. The kernels write into
+ * one caller-owned, pre-faulted output frame per case, so no allocation is timed. Each case runs a few
+ * warm-up calls, then N timed repetitions on CLOCK_MONOTONIC. Reports min/median/p99 per frame, ns and cycles per pixel and
+ * MB/s of input plus output, optionally as JSON. The output of every case is also checked against the floating-point
+ * reference of its path, with PSNR and max error per plane next to the timings (and the error histograms in the JSON).
+ * With -l on or both the frames are allocated and converted in large-frame mode, and the dTLB misses per 1000
+ * pixels of the single-threaded cases show what the huge pages save; they read "-" without a PMU.
+ */
+
+#define MAX_SIZES 16
+#define MAX_THREADS 16
+// 1/2, 1/4 and 1/8 of the frame, as a thumbnail and two preview proxies
+#define PROXY_LEVELS 3
+
+// The packed inputs hold the pixels of the raster as RGB24 and BGRA
+typedef enum { INPUT_RASTER, INPUT_RGB48, INPUT_YCBCR, INPUT_DOWNSAMPLED, INPUT_RGB24, INPUT_BGRA } input_t;
+
+typedef struct variant{
+    const char* name;
+    input_t input;
+    frame_format_t output;
+    bool threaded;          // runs on the default pool, swept over thread counts
+    void (*convert)(const uint32*, uint8*, const image_t*);
+    void (*convert48)(const uint16*, uint8*, const image_t*);
+    void (*downsample)(const uint8*, uint8*, const image_t*);
+    void (*inverse)(const uint8*, uint32*, const image_t*, upsample_t);   // 4:2:0 input, RGBA raster output
+    upsample_t upsample;
+    subsampling_t subsampling;  // of the downsampling variants, box 4:2:0 unless set
+    void (*convert_packed)(const uint8*, pixel_format_t, uint8*, const image_t*);
+    void (*proxies)(const uint32*, uint8* const*, uint32, bool, const image_t*);    // PROXY_LEVELS frames one after the other
+} variant_t;
+
+typedef struct result{
+    double min_ns;
+    double median_ns;
+    double p99_ns;
+    double cycles;          // median cycles per frame
+    double tlb_misses;      // dTLB load and store misses per frame of the calling thread, NAN when not counted
+    int reps;
+} result_t;
+
+typedef struct options{
+    int reps;
+    int warmup;
+    double max_seconds;     // time budget per case, caps reps for large frames
+    const char* filter;
+    const char* json;
+    uint32 sizes[MAX_SIZES][2];
+    int n_sizes;
+    int threads[MAX_THREADS];
+    int n_threads;
+    int max_error;          // error budget, cases past it are flagged, -1 for none
+    color_space_t space;
+    bool modes[2];          // runs without and with large-frame mode
+    const kernel_table_t* isas[ISA_KERNELS];    // instruction sets to measure, the widest one unless -i picks others
+    uint32 n_isas;
+} options_t;
+
+
+static const variant_t variants[] = {
+    {.name = "convert/float",            .input = INPUT_RASTER,      .output = FRAME_YCBCR,    .convert = convert_rgb_to_ycbcr_into},
+    {.name = "convert/fixed",            .input = INPUT_RASTER,      .output = FRAME_YCBCR,    .convert = convert_rgb_to_ycbcr_v1_into},
+    {.name = "convert/pipelined",        .input = INPUT_RASTER,      .output = FRAME_YCBCR,    .convert = convert_rgb_to_ycbcr_v2_into},
+    {.name = "convert/shift",            .input = INPUT_RASTER,      .output = FRAME_YCBCR,    .convert = convert_rgb_to_ycbcr_v2_5_into},
+    {.name = "convert/lut",              .input = INPUT_RASTER,      .output = FRAME_YCBCR,    .convert = convert_rgb_to_ycbcr_lut_into},
+    {.name = "convert/simd",             .input = INPUT_RASTER,      .output = FRAME_YCBCR,    .convert = convert_rgb_to_ycbcr_v3_into},
+    {.name = "convert/simd-mt",          .input = INPUT_RASTER,      .output = FRAME_YCBCR,    .threaded = true, .convert = convert_rgb_to_ycbcr_v4_into},
+    {.name = "convert/rgb24",            .input = INPUT_RGB24,       .output = FRAME_YCBCR,    .convert_packed = convert_packed_to_ycbcr_simd_into},
+    {.name = "convert/bgra",             .input = INPUT_BGRA,        .output = FRAME_YCBCR,    .convert_packed = convert_packed_to_ycbcr_simd_into},
+    {.name = "convert48/fixed",          .input = INPUT_RGB48,       .output = FRAME_YCBCR,    .convert48 = convert_rgb48_to_ycbcr_v1_into},
+    {.name = "convert48/lut",            .input = INPUT_RGB48,       .output = FRAME_YCBCR,    .convert48 = convert_rgb48_to_ycbcr_lut_into},
+    {.name = "convert48/simd",           .input = INPUT_RGB48,       .output = FRAME_YCBCR,    .convert48 = convert_rgb48_to_ycbcr_simd_into},
+    {.name = "convert48/precise",        .input = INPUT_RGB48,       .output = FRAME_YCBCR,    .convert48 = convert_rgb48_to_ycbcr_precise_into},
+    {.name = "downsample/unoptimized",   .input = INPUT_YCBCR,       .output = FRAME_YCBCR420, .downsample = downsample_ycbcr_into},
+    {.name = "downsample/shift",         .input = INPUT_YCBCR,       .output = FRAME_YCBCR420, .downsample = downsample_ycbcr_v1_into},
+    {.name = "downsample/fill-backfill", .input = INPUT_YCBCR,       .output = FRAME_YCBCR420, .downsample = downsample_ycbcr_v2_into},
+    {.name = "downsample/simd",          .input = INPUT_YCBCR,       .output = FRAME_YCBCR420, .downsample = downsample_ycbcr_simd_into},
+    {.name = "downsample/simd-mt",       .input = INPUT_YCBCR,       .output = FRAME_YCBCR420, .threaded = true, .downsample = downsample_ycbcr_v4_into},
+    {.name = "downsample/i420",          .input = INPUT_YCBCR,       .output = FRAME_I420,     .downsample = downsample_ycbcr_i420_simd_into},
+    {.name = "downsample/nv12",          .input = INPUT_YCBCR,       .output = FRAME_NV12,     .downsample = downsample_ycbcr_nv12_simd_into},
+    {.name = "downsample/422",           .input = INPUT_YCBCR,       .output = FRAME_YCBCR422,
+     .downsample = downsample_ycbcr_422_simd_into, .subsampling = SUBSAMPLING_422},
+    {.name = "downsample/411",           .input = INPUT_YCBCR,       .output = FRAME_YCBCR411,
+     .downsample = downsample_ycbcr_411_simd_into, .subsampling = SUBSAMPLING_411},
+    {.name = "downsample/444",           .input = INPUT_YCBCR,       .output = FRAME_YCBCR,
+     .downsample = downsample_ycbcr_444_into, .subsampling = SUBSAMPLING_444},
+    {.name = "downsample/420-cosited",   .input = INPUT_YCBCR,       .output = FRAME_YCBCR420,
+     .downsample = downsample_ycbcr_cosited_simd_into, .subsampling = SUBSAMPLING_420_COSITED},
+    {.name = "convert420/two-stage",     .input = INPUT_RASTER,      .output = FRAME_YCBCR420, .convert = convert_rgb_to_ycbcr420_two_stage_into},
+    {.name = "convert420/fused",         .input = INPUT_RASTER,      .output = FRAME_YCBCR420, .convert = convert_rgb_to_ycbcr420_simd_into},
+    {.name = "convert420/fused-mt",      .input = INPUT_RASTER,      .output = FRAME_YCBCR420, .threaded = true, .convert = convert_rgb_to_ycbcr420_v4_into},
+    {.name = "convert420/i420",          .input = INPUT_RASTER,      .output = FRAME_I420,     .convert = convert_rgb_to_i420_simd_into},
+    {.name = "convert420/nv12",          .input = INPUT_RASTER,      .output = FRAME_NV12,     .convert = convert_rgb_to_nv12_simd_into},
+    {.name = "convert420/i420-rgb24",    .input = INPUT_RGB24,       .output = FRAME_I420,     .convert_packed = convert_packed_to_i420_simd_into},
+    {.name = "convert420/i420-bgra",     .input = INPUT_BGRA,        .output = FRAME_I420,     .convert_packed = convert_packed_to_i420_simd_into},
+    {.name = "convert420/i420-mt",       .input = INPUT_RASTER,      .output = FRAME_I420,     .threaded = true, .convert = convert_rgb_to_i420_v4_into},
+    {.name = "convert420/nv12-mt",       .input = INPUT_RASTER,      .output = FRAME_NV12,     .threaded = true, .convert = convert_rgb_to_nv12_v4_into},
+    {.name = "inverse/nearest",          .input = INPUT_DOWNSAMPLED, .output = FRAME_RGBA,     .inverse = convert_ycbcr420_to_rgb_simd_into},
+    {.name = "inverse/bilinear",         .input = INPUT_DOWNSAMPLED, .output = FRAME_RGBA,
+     .inverse = convert_ycbcr420_to_rgb_simd_into, .upsample = UPSAMPLE_BILINEAR},
+    {.name = "inverse/nearest-mt",       .input = INPUT_DOWNSAMPLED, .output = FRAME_RGBA,     .threaded = true, .inverse = convert_ycbcr420_to_rgb_v4_into},
+    {.name = "inverse/bilinear-mt",      .input = INPUT_DOWNSAMPLED, .output = FRAME_RGBA,
+     .threaded = true, .inverse = convert_ycbcr420_to_rgb_v4_into, .upsample = UPSAMPLE_BILINEAR},
+    {.name = "proxy/444",                .input = INPUT_RASTER,      .output = FRAME_YCBCR,    .proxies = convert_rgb_to_proxies_simd_into},
+    {.name = "proxy/i420",               .input = INPUT_RASTER,      .output = FRAME_I420,     .proxies = convert_rgb_to_proxies_simd_into},
+    {.name = "proxy/444-mt",             .input = INPUT_RASTER,      .output = FRAME_YCBCR,    .threaded = true, .proxies = convert_rgb_to_proxies_v4_into},
+    {.name = "proxy/i420-mt",            .input = INPUT_RASTER,      .output = FRAME_I420,     .threaded = true, .proxies = convert_rgb_to_proxies_v4_into},
+};
+
+
+// Cycle counter: TSC on x86, the generic timer (a fixed rate, not core cycles) on ARM
+static inline uint64 read_cycles(void){
+#if defined(ARCH_X86)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64 ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return 0;
+#endif
+}
+
+
+// dTLB load and store miss counters of the calling thread, -1 where the kernel or the machine has none
+static int tlb_counters[2] = {-1, -1};
+
+static void open_tlb_counters(void){
+    static const uint64 ops[2] = {PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_OP_WRITE};
+    struct perf_event_attr attr;
+
+    for (int i = 0; i < 2; ++i) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | ops[i] << 8 | (uint64) PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        tlb_counters[i] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+}
+
+
+// Misses counted so far by the counters that could be opened, NAN if none
+static double read_tlb_misses(void){
+    double misses = NAN;
+    uint64 value;
+
+    for (int i = 0; i < 2; ++i) {
+        if (tlb_counters[i] >= 0 && read(tlb_counters[i], &value, sizeof(value)) == sizeof(value)) {
+            misses = (isnan(misses) ? 0 : misses) + (double) value;
+        }
+    }
+    return misses;
+}
+
+
+static inline double now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static int compare_doubles(const void* a, const void* b){
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+
+// Splits frame into the PROXY_LEVELS frames of the proxies in the format, frames may be NULL; returns the bytes of all of them
+static size_t proxy_frames(uint8* frame, frame_format_t format, const image_t* image, uint8** frames){
+    size_t bytes = 0;
+
+    for (uint32 level = 1; level <= PROXY_LEVELS; ++level) {
+        image_t proxy = proxy_image(image, level);
+        if (frames != NULL) {
+            frames[level - 1] = frame + bytes;
+        }
+        bytes += frame_format_size(&proxy, format);
+    }
+    return bytes;
+}
+
+
+static void run_variant(const variant_t* variant, const void* input, uint8* output, const image_t* image){
+    uint8* proxies[PROXY_LEVELS];
+
+    switch (variant->input) {
+        case INPUT_RASTER:
+            if (variant->proxies != NULL) {
+                proxy_frames(output, variant->output, image, proxies);
+                variant->proxies((const uint32*) input, proxies, PROXY_LEVELS, variant->output == FRAME_I420, image);
+                break;
+            }
+            variant->convert((const uint32*) input, output, image);
+            break;
+        case INPUT_RGB48:
+            variant->convert48((const uint16*) input, output, image);
+            break;
+        case INPUT_DOWNSAMPLED:
+            variant->inverse((const uint8*) input, (uint32*) output, image, variant->upsample);
+            break;
+        case INPUT_RGB24:
+        case INPUT_BGRA:
+            variant->convert_packed((const uint8*) input, variant->input == INPUT_RGB24 ? PIXEL_RGB24 : PIXEL_BGRA, output, image);
+            break;
+        default:
+            variant->downsample((const uint8*) input, output, image);
+    }
+}
+
+
+static result_t run_case(const variant_t* variant, const void* input, uint8* output, const image_t* image, const options_t* options){
+    result_t result;
+    int reps = options->reps;
+    double* samples = malloc(sizeof(double) * reps);
+    double* cycles = malloc(sizeof(double) * reps);
+    double warmup_ns = 0;
+
+    if (samples == NULL || cycles == NULL) {
+        printf("[-] \033[0;31mCould not allocate %d samples\033[0m\n", reps);
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < options->warmup; ++i) {
+        double start = now_ns();
+        run_variant(variant, input, output, image);
+        warmup_ns = now_ns() - start;
+    }
+    // keep large cases within the time budget, but never below 5 samples
+    if (warmup_ns > 0 && warmup_ns * reps > options->max_seconds * 1e9) {
+        reps = (int) (options->max_seconds * 1e9 / warmup_ns);
+        reps = reps < 5 ? 5 : reps;
+        reps = reps > options->reps ? options->reps : reps;
+    }
+
+    double tlb_start = read_tlb_misses();
+    for (int i = 0; i < reps; ++i) {
+        double start = now_ns();
+        uint64 start_cycles = read_cycles();
+        run_variant(variant, input, output, image);
+        uint64 stop_cycles = read_cycles();
+        samples[i] = now_ns() - start;
+        cycles[i] = (double) (stop_cycles - start_cycles);
+    }
+    // the counters follow the calling thread only, the pool workers of the threaded cases are not in them
+    result.tlb_misses = variant->threaded ? NAN : (read_tlb_misses() - tlb_start) / reps;
+
+    qsort(samples, reps, sizeof(double), compare_doubles);
+    qsort(cycles, reps, sizeof(double), compare_doubles);
+    result.reps = reps;
+    result.min_ns = samples[0];
+    result.median_ns = (reps & 1) ? samples[reps / 2] : (samples[reps / 2 - 1] + samples[reps / 2]) / 2;
+    result.p99_ns = samples[(int) ((reps * 99 + 99) / 100) - 1];
+    result.cycles = cycles[reps / 2];
+
+    free(samples);
+    free(cycles);
+    return result;
+}
+
+
+static size_t input_size(const variant_t* variant, const image_t* image){
+    size_t pixels = (size_t) image->stride * image->height;
+    switch (variant->input) {
+        case INPUT_RASTER:
+            return pixels * sizeof(uint32);
+        case INPUT_RGB48:
+            return pixels * image->channels * sizeof(uint16);
+        case INPUT_DOWNSAMPLED:
+            return DOWNSAMPLED_FRAME_SIZE(image);
+        case INPUT_RGB24:
+            return pixels * 3;
+        case INPUT_BGRA:
+            return pixels * 4;
+        default:
+            return YCBCR_FRAME_SIZE(image);
+    }
+}
+
+
+// Bytes written by the variant, all levels for the proxies
+static size_t output_size(const variant_t* variant, const image_t* image){
+    if (variant->proxies != NULL) {
+        return proxy_frames(NULL, variant->output, image, NULL);
+    }
+    return frame_format_size(image, variant->output);
+}
+
+
+// Planar 4:2:0 outputs are checked against a macro-pixel reference
+static frame_format_t reference_format(const variant_t* variant){
+    return (variant->output == FRAME_I420 || variant->output == FRAME_NV12) ? FRAME_YCBCR420 : variant->output;
+}
+
+
+/**
+ * Reference proxies: every level halved from the one above with the scalar kernel, so the rounding of
+ * the cascade is in the reference too, then converted in floating point, and for 4:2:0 downsampled.
+ */
+static void compute_proxy_reference(const variant_t* variant, const uint32* raster, uint8* reference, const image_t* image){
+    image_t proxy = proxy_image(image, 1);
+    uint32* halves[2] = {malloc((size_t) proxy.width * proxy.height * sizeof(uint32)), malloc((size_t) proxy.width * proxy.height * sizeof(uint32))};
+    uint8* ycbcr = malloc(YCBCR_FRAME_SIZE(&proxy));
+    uint8* levels[PROXY_LEVELS];
+    const uint32* source = raster;
+    image_t source_image = *image;
+
+    if (halves[0] == NULL || halves[1] == NULL || ycbcr == NULL) {
+        printf("[-] \033[0;31mCould not allocate the proxy reference\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+
+    proxy_frames(reference, reference_format(variant), image, levels);
+    for (uint32 level = 1; level <= PROXY_LEVELS; ++level) {
+        uint32* half = halves[level & 1];
+        proxy = proxy_image(image, level);
+        halve_rows_scalar(source, half, &source_image, proxy.stride, source_image.height);
+        if (variant->output == FRAME_YCBCR) {
+            convert_rgb_to_ycbcr_into(half, levels[level - 1], &proxy);
+        } else {
+            convert_rgb_to_ycbcr_into(half, ycbcr, &proxy);
+            downsample_ycbcr_into(ycbcr, levels[level - 1], &proxy);
+        }
+        source = half;
+        source_image = proxy;
+    }
+    free(ycbcr);
+    free(halves[1]);
+    free(halves[0]);
+}
+
+
+// compare_frames() over every level of the proxies, the errors of the levels summed up per plane
+static void compare_output(const variant_t* variant, const uint8* reference, uint8* output, const image_t* image, frame_error_t* error){
+    uint8* reference_levels[PROXY_LEVELS];
+    uint8* output_levels[PROXY_LEVELS];
+    frame_error_t level_error;
+
+    if (variant->proxies == NULL) {
+        compare_frames(reference, reference_format(variant), output, variant->output, image, error);
+        return;
+    }
+    proxy_frames((uint8*) reference, reference_format(variant), image, reference_levels);
+    proxy_frames(output, variant->output, image, output_levels);
+    for (uint32 level = 1; level <= PROXY_LEVELS; ++level) {
+        image_t proxy = proxy_image(image, level);
+        compare_frames(reference_levels[level - 1], reference_format(variant), output_levels[level - 1], variant->output, &proxy,
+                       level == 1 ? error : &level_error);
+        for (int p = 0; level > 1 && p < 3; ++p) {
+            sample_error_t* plane = &error->planes[p];
+            plane->samples += level_error.planes[p].samples;
+            plane->sum_squares += level_error.planes[p].sum_squares;
+            for (int bin = 0; bin < ERROR_BINS; ++bin) {
+                plane->histogram[bin] += level_error.planes[p].histogram[bin];
+            }
+            plane->max_error = level_error.planes[p].max_error > plane->max_error ? level_error.planes[p].max_error : plane->max_error;
+        }
+    }
+}
+
+
+// Floating-point reference output of the path of the variant, scratch holds the 4:4:4 frame in between; the packed inputs pass the raster
+static void compute_reference(const variant_t* variant, const void* input, uint8* reference, uint8* scratch, const image_t* image){
+    switch (variant->input) {
+        case INPUT_RASTER:
+        case INPUT_RGB24:
+        case INPUT_BGRA:
+            if (variant->proxies != NULL) {
+                compute_proxy_reference(variant, (const uint32*) input, reference, image);
+                break;
+            }
+            if (variant->output == FRAME_YCBCR) {
+                convert_rgb_to_ycbcr_into((const uint32*) input, reference, image);
+                break;
+            }
+            convert_rgb_to_ycbcr_into((const uint32*) input, scratch, image);
+            downsample_ycbcr_into(scratch, reference, image);
+            break;
+        case INPUT_RGB48:
+            convert_rgb48_to_ycbcr_into((const uint16*) input, reference, image);
+            break;
+        case INPUT_YCBCR:
+            subsample_ycbcr_into((const uint8*) input, reference, image, variant->subsampling);
+            break;
+        default:
+            convert_ycbcr420_to_rgb_into((const uint8*) input, (uint32*) reference, image, variant->upsample);
+    }
+}
+
+
+static void json_psnr(FILE* json, double psnr){
+    if (isinf(psnr)) {
+        fprintf(json, "null");
+    } else {
+        fprintf(json, "%.3f", psnr);
+    }
+}
+
+
+static void report(FILE* json, bool* first, const variant_t* variant, const image_t* image, int n_threads, const result_t* result,
+                   const frame_error_t* error, int max_error){
+    double pixels = (double) image->width * image->height;
+    double bytes = (double) input_size(variant, image) + output_size(variant, image);
+    double ns_per_px = result->median_ns / pixels;
+    double mb_per_s = bytes / (result->median_ns / 1e9) / 1e6;
+    double cycles_per_px = result->cycles / pixels;
+    double tlb_per_kpx = result->tlb_misses * 1000 / pixels;
+    char tlb[16] = "-";
+
+    bool within_budget = max_error < 0 || frame_max_error(error) <= max_error;
+
+    if (!isnan(tlb_per_kpx)) {
+        snprintf(tlb, sizeof(tlb), "%.3f", tlb_per_kpx);
+    }
+    printf("%-26s %5ux%-5u %5s %3d %4d %12.0f %12.0f %12.0f %8.3f %9.1f %8.2f %9s %7.2f %7.2f %7.2f %4u%s\n", variant->name, image->width,
+           image->height, large_frames ? "large" : "-", n_threads, result->reps, result->min_ns, result->median_ns, result->p99_ns, ns_per_px,
+           mb_per_s, cycles_per_px, tlb, plane_psnr(&error->planes[0]), plane_psnr(&error->planes[1]), plane_psnr(&error->planes[2]),
+           frame_max_error(error), within_budget ? "" : " over budget");
+
+    if (json != NULL) {
+        fprintf(json, "%s\n    {\"variant\": \"%s\", \"kernels\": \"%s\", \"width\": %u, \"height\": %u, \"large_frames\": %s, \"threads\": %d, "
+                      "\"reps\": %d, \"min_ns\": %.0f, \"median_ns\": %.0f, \"p99_ns\": %.0f, \"ns_per_px\": %.4f, \"mb_per_s\": %.1f, \"cycles_per_px\": %.3f",
+                *first ? "" : ",", variant->name, kernels->name, image->width, image->height, large_frames ? "true" : "false", n_threads,
+                result->reps, result->min_ns, result->median_ns, result->p99_ns, ns_per_px, mb_per_s, cycles_per_px);
+        // dTLB misses are null where they were not counted
+        fprintf(json, ", \"dtlb_misses_per_kpx\": ");
+        if (isnan(tlb_per_kpx)) {
+            fprintf(json, "null");
+        } else {
+            fprintf(json, "%.3f", tlb_per_kpx);
+        }
+        // PSNR is null for planes identical to the reference
+        fprintf(json, ", \"planes\": [");
+        for (int plane = 0; plane < 3; ++plane) {
+            fprintf(json, "%s{\"plane\": \"%s\", \"psnr\": ", plane ? ", " : "", error->plane_names[plane]);
+            json_psnr(json, plane_psnr(&error->planes[plane]));
+            fprintf(json, ", \"max_error\": %u, \"histogram\": [", error->planes[plane].max_error);
+            for (int bin = 0; bin < ERROR_BINS; ++bin) {
+                fprintf(json, "%s%" PRIu64, bin ? ", " : "", error->planes[plane].histogram[bin]);
+            }
+            fprintf(json, "]}");
+        }
+        fprintf(json, "], \"within_budget\": %s}", within_budget ? "true" : "false");
+        *first = false;
+    }
+}
+
+
+static void fill_random(void* buffer, size_t size){
+    uint32 state = 0x12345678;
+    uint8* bytes = (uint8*) buffer;
+    for (size_t i = 0; i < size; ++i) {
+        // xorshift, any deterministic noise will do
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        bytes[i] = (uint8) state;
+    }
+}
+
+
+static void usage(const char* name){
+    printf("usage: %s [-r reps] [-w warmup] [-m max seconds per case] [-s WxH,...] [-t threads,...] [-f filter] [-e max error] [-y color space] [-l off|on|both] [-i isa,...|all] [-j out.json]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+
+static void parse_options(int argc, char* argv[], options_t* options){
+    static const uint32 default_sizes[][2] = {{64, 64}, {256, 256}, {640, 480}, {1280, 720}, {1920, 1080}, {3840, 2160}, {7680, 4320}};
+    const kernel_table_t* supported[ISA_KERNELS];
+    uint32 n_supported = supported_kernels(supported);
+    cpu_set_t cpus;
+
+    options->reps = 25;
+    options->warmup = 3;
+    options->max_seconds = 2.0;
+    options->filter = NULL;
+    options->json = NULL;
+    options->max_error = -1;
+    options->space = color_space;
+    options->modes[0] = true;
+    options->modes[1] = false;
+    options->isas[0] = supported[0];
+    options->n_isas = 1;
+    options->n_sizes = sizeof(default_sizes) / sizeof(default_sizes[0]);
+    memcpy(options->sizes, default_sizes, sizeof(default_sizes));
+
+    // 1, 2, 4, ... and every CPU we may run on
+    CPU_ZERO(&cpus);
+    int max_threads = (sched_getaffinity(0, sizeof(cpu_set_t), &cpus) == 0) ? CPU_COUNT(&cpus) : 1;
+    options->n_threads = 0;
+    for (int n = 1; options->n_threads < MAX_THREADS; n *= 2) {
+        options->threads[options->n_threads++] = n < max_threads ? n : max_threads;
+        if (n >= max_threads) {
+            break;
+        }
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' || i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        char* value = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'r':
+                options->reps = atoi(value) > 0 ? atoi(value) : 1;
+                break;
+            case 'w':
+                options->warmup = atoi(value) >= 0 ? atoi(value) : 0;
+                break;
+            case 'm':
+                options->max_seconds = atof(value);
+                break;
+            case 'f':
+                options->filter = value;
+                break;
+            case 'j':
+                options->json = value;
+                break;
+            case 'e':
+                options->max_error = atoi(value);
+                break;
+            case 'y':
+                if (!parse_color_space(value, &options->space)) {
+                    usage(argv[0]);
+                }
+                break;
+            case 'l':
+                if (strcmp(value, "off") != 0 && strcmp(value, "on") != 0 && strcmp(value, "both") != 0) {
+                    usage(argv[0]);
+                }
+                options->modes[0] = strcmp(value, "on") != 0;
+                options->modes[1] = strcmp(value, "off") != 0;
+                break;
+            case 's':
+                options->n_sizes = 0;
+                for (char* size = strtok(value, ","); size != NULL && options->n_sizes < MAX_SIZES; size = strtok(NULL, ",")) {
+                    if (sscanf(size, "%ux%u", &options->sizes[options->n_sizes][0], &options->sizes[options->n_sizes][1]) != 2 ||
+                        options->sizes[options->n_sizes][0] == 0 || options->sizes[options->n_sizes][1] == 0) {
+                        usage(argv[0]);
+                    }
+                    options->n_sizes++;
+                }
+                break;
+            case 'i':
+                if (strcmp(value, "all") == 0) {
+                    memcpy(options->isas, supported, n_supported * sizeof(supported[0]));
+                    options->n_isas = n_supported;
+                    break;
+                }
+                options->n_isas = 0;
+                for (char* isa = strtok(value, ","); isa != NULL && options->n_isas < ISA_KERNELS; isa = strtok(NULL, ",")) {
+                    uint32 k = 0;
+                    while (k < n_supported && strcasecmp(isa, supported[k]->name) != 0) {
+                        ++k;
+                    }
+                    if (k == n_supported) {
+                        printf("[-] \033[0;31mThis CPU does not run %s kernels\033[0m\n", isa);
+                        exit(EXIT_FAILURE);
+                    }
+                    options->isas[options->n_isas++] = supported[k];
+                }
+                break;
+            case 't':
+                options->n_threads = 0;
+                for (char* n = strtok(value, ","); n != NULL && options->n_threads < MAX_THREADS; n = strtok(NULL, ",")) {
+                    options->threads[options->n_threads++] = atoi(n) > 0 ? atoi(n) : 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+}
+
+
+// Every size, mode and variant on the kernels select_isa_kernels() picked
+static void run_isa(const options_t* options, FILE* json, bool* first){
+    printf("[o] Using \033[1;36m%s\033[0m kernels, \033[1;36m%s\033[0m\n", kernels->name, color_space_name(&color_space));
+    printf("%-26s %11s %5s %3s %4s %12s %12s %12s %8s %9s %8s %9s %7s %7s %7s %4s\n", "variant", "size", "mode", "thr", "reps", "min ns", "median ns",
+           "p99 ns", "ns/px", "MB/s", "cyc/px", "dTLB/kpx", "Y|R dB", "Cb|G dB", "Cr|B dB", "max");
+
+    for (int s = 0; s < options->n_sizes; ++s) {
+        for (int mode = 0; mode < 2; ++mode) {
+            if (!options->modes[mode]) {
+                continue;
+            }
+            // set before the frames are allocated, which go on huge pages in large-frame mode
+            large_frames = mode == 1;
+            image_t image = {options->sizes[s][0], options->sizes[s][1], options->sizes[s][0], 4};
+            size_t pixels = (size_t) image.stride * image.height;
+            uint32* raster = (uint32*) frame_alloc(pixels * sizeof(uint32));
+            uint16* rgb48 = (uint16*) frame_alloc(pixels * image.channels * sizeof(uint16));
+            uint8* ycbcr = frame_alloc(YCBCR_FRAME_SIZE(&image));
+            uint8* downsampled = frame_alloc(DOWNSAMPLED_FRAME_SIZE(&image));
+            uint8* rgb24 = frame_alloc(pixels * 3);
+            uint8* bgra = frame_alloc(pixels * 4);
+            // big enough for the RGBA raster of the inverse kernels and the proxies of tiny frames too
+            size_t proxy_bytes = proxy_frames(NULL, FRAME_YCBCR, &image, NULL);
+            size_t output_bytes = proxy_bytes > pixels * sizeof(uint32) ? proxy_bytes : pixels * sizeof(uint32);
+            uint8* output = frame_alloc(output_bytes);
+            uint8* reference = frame_alloc(output_bytes);
+            uint8* scratch = frame_alloc(YCBCR_FRAME_SIZE(&image));
+            int reference_key = -1;
+
+            if (raster == NULL || rgb48 == NULL || ycbcr == NULL || downsampled == NULL || rgb24 == NULL || bgra == NULL || output == NULL || reference == NULL || scratch == NULL) {
+                printf("[-] \033[0;31mCould not allocate a %ux%u frame\033[0m\n", image.width, image.height);
+                exit(EXIT_FAILURE);
+            }
+            fill_random(raster, pixels * sizeof(uint32));
+            fill_random(rgb48, pixels * image.channels * sizeof(uint16));
+            convert_rgb_to_ycbcr_v3_into(raster, ycbcr, &image);
+            convert_rgb_to_ycbcr420_simd_into(raster, downsampled, &image);
+            for (size_t i = 0; i < pixels; ++i) {
+                const uint8* pixel = (const uint8*) (raster + i);
+                memcpy(rgb24 + i * 3, pixel, 3);
+                bgra[i * 4] = pixel[2];
+                bgra[i * 4 + 1] = pixel[1];
+                bgra[i * 4 + 2] = pixel[0];
+                bgra[i * 4 + 3] = pixel[3];
+            }
+            memset(output, 0, output_bytes);
+
+            for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+                const variant_t* variant = &variants[v];
+                const void* inputs[] = {raster, rgb48, ycbcr, downsampled, rgb24, bgra};
+                const void* input = inputs[variant->input];
+
+                // consecutive variants of the same path share their reference
+                int key = ((((int) variant->input * 8 + (int) reference_format(variant)) * 2 + (int) variant->upsample) * SUBSAMPLING_MODES +
+                           (int) variant->subsampling) * 2 + (variant->proxies != NULL);
+                frame_error_t error;
+
+                if (options->filter != NULL && strstr(variant->name, options->filter) == NULL) {
+                    continue;
+                }
+                if (key != reference_key) {
+                    compute_reference(variant, variant->convert_packed != NULL ? raster : input, reference, scratch, &image);
+                    reference_key = key;
+                }
+                // cleared so a kernel that leaves samples out does not pass on the output of the previous one
+                memset(output, 0, output_bytes);
+
+                if (!variant->threaded) {
+                    result_t result = run_case(variant, input, output, &image, options);
+                    compare_output(variant, reference, output, &image, &error);
+                    report(json, first, variant, &image, 1, &result, &error, options->max_error);
+                    continue;
+                }
+                for (int t = 0; t < options->n_threads; ++t) {
+                    thread_pool_t* previous = thread_pool_default();
+                    thread_pool_t* pool = thread_pool_create(options->threads[t], NULL);
+                    if (pool == NULL) {
+                        printf("[-] \033[0;31mCould not create a pool of %d threads\033[0m\n", options->threads[t]);
+                        continue;
+                    }
+                    thread_pool_set_default(pool);
+                    result_t result = run_case(variant, input, output, &image, options);
+                    compare_output(variant, reference, output, &image, &error);
+                    report(json, first, variant, &image, thread_pool_size(pool), &result, &error, options->max_error);
+                    thread_pool_destroy(pool);
+                    thread_pool_set_default(previous);
+                }
+            }
+
+            free(scratch);
+            free(reference);
+            free(output);
+            free(bgra);
+            free(rgb24);
+            free(downsampled);
+            free(ycbcr);
+            free(rgb48);
+            free(raster);
+        }
+    }
+}
+
+
+int main(int argc, char* argv[]){
+    options_t options;
+    FILE* json = NULL;
+    bool first = true;
+
+    parse_options(argc, argv, &options);
+    select_color_space(&options.space);
+    open_tlb_counters();
+
+    if (options.json != NULL && (json = fopen(options.json, "w")) == NULL) {
+        printf("[-] \033[0;31mCould not create %s\033[0m\n", options.json);
+        exit(EXIT_FAILURE);
+    }
+    if (json != NULL) {
+        fprintf(json, "{\n  \"kernels\": [");
+        for (uint32 k = 0; k < options.n_isas; ++k) {
+            fprintf(json, "%s\"%s\"", k > 0 ? ", " : "", options.isas[k][COLOR_SPACE_INDEX(&color_space)].name);
+        }
+        fprintf(json, "],\n  \"color_space\": \"%s\",\n  \"optimized\": %s,\n  \"results\": [", color_space_name(&color_space),
+#ifdef __OPTIMIZE__
+                "true"
+#else
+                "false"
+#endif
+        );
+    }
+
+    for (uint32 k = 0; k < options.n_isas; ++k) {
+        select_isa_kernels(options.isas[k]);
+        run_isa(&options, json, &first);
+    }
+
+    if (json != NULL) {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
+    }
+    thread_pool_destroy(thread_pool_default());
+    return 0;
+}
@@ -0,0 +1,1250 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+#include "conversion.h"
+#include "thread_pool.h"
+#include "frame_pool.h"
+
+typedef struct data{
+    const void* frame;
+    uint8* conv_frame;
+    const image_t* image;
+} worker_data_t;
+
+typedef struct planar_data{
+    const uint32* raster;
+    planes_t planes;
+    const image_t* image;
+} planar_worker_data_t;
+
+typedef struct rgb_data{
+    const uint8* downsampled_ycbcr;
+    uint32* raster;
+    const image_t* image;
+    upsample_t filter;
+} rgb_worker_data_t;
+
+typedef struct proxy_data{
+    const uint32* raster;
+    uint8* const* proxies;
+    uint32 levels;
+    bool i420;
+    const image_t* image;
+    uint32* scratch;            // halved rows, scratch_pixels for each band
+    size_t scratch_pixels;
+    uint32 band_strips;         // strips per band, the band of a strip picks its scratch
+} proxy_worker_data_t;
+
+
+// Simple implementation, accessing two rows at a time (benchmark)
+void downsample_ycbcr_into(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image){
+    uint32 row_size = image->stride * 3;
+
+    for (uint32 row = 0; row < image->height; row+=2) {
+        // odd heights and widths repeat the last row/column
+        uint32 next_row = (row + 1 < image->height) ? row_size : 0;
+        const uint8* pixel = ycbcr + row * row_size;
+        uint8* downsampled_pixel = downsampled_ycbcr + (row / 2) * DOWNSAMPLED_ROW_SIZE(image);
+
+        for (uint32 col = 0; col < image->width; col+=2) {
+            uint32 next = (col + 1 < image->width) ? 3 : 0;
+
+            // store y00,y01,y10,y11,avg(cb00,cb01,cb10,cb11),avg(cr00,cr01,cr10,cr11)
+            downsampled_pixel[0] = pixel[0]; //y00
+            downsampled_pixel[1] = pixel[next]; //y01
+            downsampled_pixel[2] = pixel[next_row]; //y10
+            downsampled_pixel[3] = pixel[next_row+next]; //y11
+            int cbSum = pixel[1] + pixel[next+1] + pixel[next_row+1] + pixel[next_row+next+1];
+            downsampled_pixel[4] = (uint8)(cbSum/4); // avg(cb00,cb01,cb10,cb11)
+            int crSum = pixel[2] + pixel[next+2] + pixel[next_row+2] + pixel[next_row+next+2];
+            downsampled_pixel[5] = (uint8)(crSum/4); // avg(cr00,cr01,cr10,cr11)
+
+            pixel+=6;
+            downsampled_pixel+=6;
+        }
+    }
+}
+
+
+// Simple implementation, using bit shifting instead of division
+void downsample_ycbcr_v1_into(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image){
+    uint32 row_size = image->stride * 3;
+
+    for (uint32 row = 0; row < image->height; row+=2) {
+        // odd heights and widths repeat the last row/column
+        uint32 next_row = (row + 1 < image->height) ? row_size : 0;
+        const uint8* pixel = ycbcr + row * row_size;
+        uint8* downsampled_pixel = downsampled_ycbcr + (row / 2) * DOWNSAMPLED_ROW_SIZE(image);
+
+        for (uint32 col = 0; col < image->width; col+=2) {
+            uint32 next = (col + 1 < image->width) ? 3 : 0;
+
+            // store y00,y01,y10,y11,avg(cb00,cb01,cb10,cb11),avg(cr00,cr01,cr10,cr11)
+            downsampled_pixel[0] = pixel[0]; //y00
+            downsampled_pixel[1] = pixel[next]; //y01
+            downsampled_pixel[2] = pixel[next_row]; //y10
+            downsampled_pixel[3] = pixel[next_row+next]; //y11
+            downsampled_pixel[4] = (uint8)((pixel[1] + pixel[next+1] + pixel[next_row+1] + pixel[next_row+next+1]) >> 2); // avg(cb00,cb01,cb10,cb11)
+            downsampled_pixel[5] = (uint8)((pixel[2] + pixel[next+2] + pixel[next_row+2] + pixel[next_row+next+2]) >> 2); // avg(cr00,cr01,cr10,cr11)
+
+            pixel+=6;
+            downsampled_pixel+=6;
+        }
+    }
+}
+
+
+// Accessing one row at a time and back filling, hoping for less cache misses.
+void downsample_ycbcr_v2_into(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image){
+    uint32 row_size = image->stride * 3;
+    bool backfill = false;
+    // Cb/Cr sums of the fill row, one pair per macro-pixel until the backfill row comes
+    uint16* chroma_sums = malloc(sizeof(uint16) * (image->width + 1));
+    if (chroma_sums == NULL) {
+        printf("[-] \033[0;31mCould not allocate the chroma sums\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // an odd height backfills from the last row a second time
+    for (uint32 row = 0; row < ((image->height + 1) & ~1u); ++row) {
+        // even rows fill, odd rows backfill the same macro-pixel row
+        backfill = row & 1;
+        const uint8* pixel = ycbcr + (row < image->height ? row : image->height - 1) * row_size;
+        uint8* downsampled_pixel = downsampled_ycbcr + (row / 2) * DOWNSAMPLED_ROW_SIZE(image);
+
+        for (uint32 col = 0; col < image->width; col+=2) {
+            uint32 next = (col + 1 < image->width) ? 3 : 0;
+
+            if (!backfill){
+                // if(first row to downsample)
+                //      store y00,y01,_,_,sum(cb00,cb01),sum(cr00,cr01)
+                downsampled_pixel[0] = pixel[0];
+                downsampled_pixel[1] = pixel[next];
+                chroma_sums[col] = (pixel[1] + pixel[next+1]);
+                chroma_sums[col+1] = (pixel[2] + pixel[next+2]);
+            }
+            else if (backfill){
+                // if(second row to downsample)
+                //      store _,_,y10,y11,avg(cb00,cb01,cb10,cb11),avg(cr00,cr01,cr10,cr11)
+                downsampled_pixel[2] = pixel[0];
+                downsampled_pixel[3] = pixel[next];
+                downsampled_pixel[4] = (pixel[1] + pixel[next+1] + chroma_sums[col]) >> 2;
+                downsampled_pixel[5] = (pixel[2] + pixel[next+2] + chroma_sums[col+1]) >> 2;
+            }
+
+            pixel+=6;
+            downsampled_pixel+=6;
+        }
+    }
+    free(chroma_sums);
+}
+
+
+/**
+ * Plain reference of every subsampling mode: rounded averages of the whole block for 4:2:2 and 4:1:1,
+ * the exact [1 2 1] filter for co-sited 4:2:0. Box 4:2:0 is downsample_ycbcr_into().
+ */
+void subsample_ycbcr_into(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, subsampling_t subsampling){
+    const subsampling_mode_t* mode = &subsampling_modes[subsampling];
+    uint32 row_size = image->stride * 3;
+    uint32 block_size = mode->horizontal * mode->vertical + 2;
+
+    if (subsampling == SUBSAMPLING_420) {
+        downsample_ycbcr_into(ycbcr, subsampled_ycbcr, image);
+        return;
+    }
+    if (subsampling == SUBSAMPLING_444) {
+        memcpy(subsampled_ycbcr, ycbcr, YCBCR_FRAME_SIZE(image));
+        return;
+    }
+    if (subsampling == SUBSAMPLING_420_COSITED) {
+        downsample420_cosited_rows_scalar(ycbcr, subsampled_ycbcr, image, 0, image->height);
+        return;
+    }
+
+    // 4:2:2 and 4:1:1 blocks are one row high
+    for (uint32 row = 0; row < image->height; ++row) {
+        const uint8* row_ptr = ycbcr + (size_t) row * row_size;
+        uint8* block = subsampled_ycbcr + row * SUBSAMPLED_ROW_SIZE(image, mode->horizontal, mode->vertical);
+
+        for (uint32 col = 0; col < image->width; col+=mode->horizontal) {
+            int cb_sum = 0, cr_sum = 0;
+            for (int k = 0; k < mode->horizontal; ++k) {
+                // columns past the width repeat the last one
+                const uint8* pixel = row_ptr + (col + k < image->width ? col + k : image->width - 1) * 3;
+                block[k] = pixel[0];
+                cb_sum += pixel[1];
+                cr_sum += pixel[2];
+            }
+            block[mode->horizontal] = (uint8) ((cb_sum + mode->horizontal / 2) / mode->horizontal);
+            block[mode->horizontal + 1] = (uint8) ((cr_sum + mode->horizontal / 2) / mode->horizontal);
+            block += block_size;
+        }
+    }
+}
+
+
+void matrix_weights(color_matrix_t matrix, double* kr, double* kb){
+    static const double weights[3][2] = {{0.299, 0.114}, {0.2126, 0.0722}, {0.2627, 0.0593}};
+    *kr = weights[matrix][0];
+    *kb = weights[matrix][1];
+}
+
+
+/**
+ * Floating-point coefficients of the selected color space for the references, straight from Kr, Kb and
+ * the range rather than rounded like the constants of the kernels. Cb and Cr have their 128 added apart.
+ */
+typedef struct reference_coefficients{
+    double y[3], cb[3], cr[3];      // R, G, B weights
+    double y_offset;
+    double inverse_y, inverse_cr_r, inverse_cb_g, inverse_cr_g, inverse_cb_b;
+} reference_coefficients_t;
+
+static reference_coefficients_t reference_coefficients(void){
+    double kr, kb;
+    matrix_weights(color_space.matrix, &kr, &kb);
+    double kg = 1.0 - kr - kb;
+    bool studio = color_space.range == RANGE_STUDIO;
+    double y_scale = studio ? 219.0 / 255.0 : 1.0;
+    double c_scale = studio ? 224.0 / 255.0 : 1.0;
+    reference_coefficients_t c = {
+        {y_scale * kr, y_scale * kg, y_scale * kb},
+        {-c_scale * kr / (2 * (1 - kb)), -c_scale * kg / (2 * (1 - kb)), c_scale / 2},
+        {c_scale / 2, -c_scale * kg / (2 * (1 - kr)), -c_scale * kb / (2 * (1 - kr))},
+        studio ? 16.0 : 0.0,
+        1 / y_scale, 2 * (1 - kr) / c_scale, 2 * (1 - kb) * kb / (kg * c_scale), 2 * (1 - kr) * kr / (kg * c_scale), 2 * (1 - kb) / c_scale
+    };
+    return c;
+}
+
+
+void convert_rgb_to_ycbcr_into(const uint32* raster, uint8* ycbcr, const image_t* image){
+    reference_coefficients_t c = reference_coefficients();
+
+    /**
+     * The image is currently stored as ARGB,ARGB,ARGB format we can take the first element
+     * shift it by 8 to get B, by 16 to get G and 32 to get R
+     */
+    for (uint32 row = 0; row < image->height; ++row) {
+        for (uint32 pixel = row * image->stride; pixel < row * image->stride + image->width; ++pixel) {
+            //DEBUG_PRINT("[o] Converting Pixel %d: [\033[1;31mRed: %d \033[1;32mGreen: %d \033[1;34mBlue: %d\033[0m]\n", pixel, TIFFGetR(raster[pixel]), TIFFGetG(raster[pixel]), TIFFGetB(raster[pixel]));
+            Y(ycbcr, pixel, 3,  0) = (c.y[0] * TIFFGetR(raster[pixel])) + (c.y[1] * TIFFGetG(raster[pixel])) + (c.y[2] * TIFFGetB(raster[pixel])) + c.y_offset;
+            Cb(ycbcr, pixel, 3, 1) = (c.cb[0] * TIFFGetR(raster[pixel])) + (c.cb[1] * TIFFGetG(raster[pixel])) + (c.cb[2] * TIFFGetB(raster[pixel])) + 128;
+            Cr(ycbcr, pixel, 3, 2) = (c.cr[0] * TIFFGetR(raster[pixel])) + (c.cr[1] * TIFFGetG(raster[pixel])) + (c.cr[2] * TIFFGetB(raster[pixel])) + 128;
+
+            //printf("[o] Converting RGB to YCbCr: \033[1;36m%0.00f%%\033[0m \b\r", ((float) pixel/ (float) (width * height)) * 100);
+            //DEBUG_PRINT("[+] Converted Pixel %d: [\033[1;37mY: %d \033[1;36mCb: %d \033[1;35mCr: %d\033[0m]\n", pixel, Y(ycbcr, pixel), Cb(ycbcr, pixel), Cr(ycbcr, pixel));
+        }
+    }
+}
+
+
+void convert_rgb_to_ycbcr_v1_into(const uint32* raster, uint8* ycbcr, const image_t* image){
+
+    for (uint32 row = 0; row < image->height; ++row) {
+        for (uint32 i = row * image->stride; i < row * image->stride + image->width; ++i) {
+            Y(ycbcr, i, 3,  0)= 16 + ((65 * TIFFGetR(raster[i])) + (129 * TIFFGetG(raster[i])) + (25 * TIFFGetB(raster[i])) >> 8);
+            Cb(ycbcr, i, 3, 1)  = 128 + ((-38 * TIFFGetR(raster[i])) - (74 * TIFFGetG(raster[i])) + (112 * TIFFGetB(raster[i]))  >> 8);
+            Cr(ycbcr, i, 3, 2)  = 128 + ((112 * TIFFGetR(raster[i])) - (94 * TIFFGetG(raster[i])) - (18 * TIFFGetB(raster[i])) >> 8);
+        }
+    }
+}
+
+
+void convert_rgb_to_ycbcr_v2_into(const uint32* raster, uint8* ycbcr, const image_t* image){
+
+    register uint16 tempY, tempCb, tempCr;
+    register uint32 tempPixel;
+    register uint8 r, g, b;
+
+    for (uint32 row = 0; row < image->height; ++row) {
+        // the pipeline is restarted at the beginning of every row
+        uint32 first = row * image->stride;
+        uint32 last = first + image->width;
+        tempPixel = raster[first];
+        r = TIFFGetR(tempPixel);
+        g = TIFFGetG(tempPixel);
+        b = TIFFGetB(tempPixel);
+
+        for (register uint32 pixel = first + 1; pixel < last; pixel++) {
+
+            // convert the previous pixel while the next one is loaded
+            tempY = 16 + (((65 * r) + (129 * g) + (25 * b)) >> 8);
+            tempCb = 128 + (((-38 * r) - (74 * g) + (112 * b)) >> 8);
+            tempCr = 128 + (((112 * r) - (94 * g) - (18 * b)) >> 8);
+
+
+            tempPixel = raster[pixel];
+            r =  TIFFGetR(tempPixel);
+            g =  TIFFGetG(tempPixel);
+            b =  TIFFGetB(tempPixel);
+
+
+            Y(ycbcr, (pixel - 1), 3, 0) = tempY;
+            Cb(ycbcr, (pixel - 1), 3, 1) = tempCb;
+            Cr(ycbcr, (pixel - 1), 3, 2) = tempCr;
+        }
+
+        // the last pixel of the row is still in the pipeline
+        Y(ycbcr, (last - 1), 3, 0) = 16 + (((65 * r) + (129 * g) + (25 * b)) >> 8);
+        Cb(ycbcr, (last - 1), 3, 1) = 128 + (((-38 * r) - (74 * g) + (112 * b)) >> 8);
+        Cr(ycbcr, (last - 1), 3, 2) = 128 + (((112 * r) - (94 * g) - (18 * b)) >> 8);
+    }
+}
+
+
+void convert_rgb_to_ycbcr_v2_5_into(const uint32* raster, uint8* ycbcr, const image_t* image){
+
+    for (uint32 row = 0; row < image->height; ++row) {
+        for (uint32 i = row * image->stride; i < row * image->stride + image->width; i++) {
+            //YCC[0] = (0.257 * red) + (0.504 * green) + (0.098 * blue) + 16;
+            Y(ycbcr, i, 3,  0) = 16 + (((TIFFGetR(raster[i])<<6)+(TIFFGetR(raster[i])<<1)+(TIFFGetG(raster[i])<<7)+TIFFGetG(raster[i])+(TIFFGetB(raster[i])<<4)+(TIFFGetB(raster[i])<<3)+TIFFGetB(raster[i])>>8));
+            //YCC[1] = (-0.148 * red) - (0.291 * green) + (0.439 * blue) + 128;
+            Cb(ycbcr, i, 3, 1) = 128 + ((-((TIFFGetR(raster[i])<<5)+(TIFFGetR(raster[i])<<2)+(TIFFGetR(raster[i])<<1))-((TIFFGetG(raster[i])<<6)+(TIFFGetG(raster[i])<<3)+(TIFFGetG(raster[i])<<1))+(TIFFGetB(raster[i])<<7)-(TIFFGetB(raster[i])<<4))>>8);
+            //YCC[2] = (0.439 * red) - (0.369 * green) - (0.071 * blue) + 128;
+            Cr(ycbcr, i, 3, 2)  = 128 + (((TIFFGetR(raster[i])<<7)-(TIFFGetR(raster[i])<<4)-((TIFFGetG(raster[i])<<6)+(TIFFGetG(raster[i])<<5)-(TIFFGetG(raster[i])<<1))-((TIFFGetB(raster[i])<<4)+(TIFFGetB(raster[i])<<1)))>>8);
+        }
+    }
+}
+
+
+// Floating-point reference of the 48-bit path, the samples scaled to 0..255 and the outputs rounded to nearest
+void convert_rgb48_to_ycbcr_into(const uint16* rgb, uint8* ycbcr, const image_t* image){
+    reference_coefficients_t c = reference_coefficients();
+
+    for (uint32 row = 0; row < image->height; ++row) {
+        for (uint32 i = row * image->stride; i < row * image->stride + image->width; ++i) {
+            const uint16* pixel = rgb + (size_t) i * image->channels;
+            double r = pixel[0] / 257.0, g = pixel[1] / 257.0, b = pixel[2] / 257.0;
+            // full range chroma reaches 255.5
+            Y(ycbcr, i, 3,  0) = clamp_sample((int32) ((c.y[0] * r) + (c.y[1] * g) + (c.y[2] * b) + c.y_offset + 0.5));
+            Cb(ycbcr, i, 3, 1) = clamp_sample((int32) ((c.cb[0] * r) + (c.cb[1] * g) + (c.cb[2] * b) + 128.5));
+            Cr(ycbcr, i, 3, 2) = clamp_sample((int32) ((c.cr[0] * r) + (c.cr[1] * g) + (c.cr[2] * b) + 128.5));
+        }
+    }
+}
+
+
+// Fixed-point arithmetic on the native 16-bit samples, the coefficients are scaled by 2^16 instead of 2^8
+void convert_rgb48_to_ycbcr_v1_into(const uint16* rgb, uint8* ycbcr, const image_t* image){
+
+    for (uint32 row = 0; row < image->height; ++row) {
+        for (uint32 i = row * image->stride; i < row * image->stride + image->width; ++i) {
+            const uint16* pixel = rgb + (size_t) i * image->channels;
+            Y(ycbcr, i, 3,  0) = 16 + (((65 * pixel[0]) + (129 * pixel[1]) + (25 * pixel[2])) >> 16);
+            Cb(ycbcr, i, 3, 1) = 128 + (((-38 * pixel[0]) - (74 * pixel[1]) + (112 * pixel[2])) >> 16);
+            Cr(ycbcr, i, 3, 2) = 128 + (((112 * pixel[0]) - (94 * pixel[1]) - (18 * pixel[2])) >> 16);
+        }
+    }
+}
+
+
+void downsample_rows_scalar(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 rows){
+    uint32 row_size = image->stride * 3;
+
+    for (uint32 row = 0; row < rows; row+=2) {
+        const uint8* row_i_ptr = ycbcr + (size_t) row * row_size;
+        // odd heights repeat the last row
+        const uint8* row_j_ptr = (row + 1 < rows) ? row_i_ptr + row_size : row_i_ptr;
+        uint8* downsampled_row = downsampled_ycbcr + (row / 2) * DOWNSAMPLED_ROW_SIZE(image);
+
+        for (uint32 col = 0; col < image->width; col+=2) {
+            uint32 next = (col + 1 < image->width) ? 3 : 0;
+            downsample_pixel_fixed(row_i_ptr + col * 3, row_j_ptr + col * 3, next, downsampled_row + col * 3);
+        }
+    }
+}
+
+
+void downsample_planar_rows_scalar(const uint8* ycbcr, const planes_t* planes, const image_t* image, uint32 rows){
+    uint32 row_size = image->stride * 3;
+    uint8 downsampled_pixel[6];
+
+    for (uint32 row = 0; row < rows; row+=2) {
+        const uint8* row_i_ptr = ycbcr + (size_t) row * row_size;
+        // odd heights repeat the last row
+        const uint8* row_j_ptr = (row + 1 < rows) ? row_i_ptr + row_size : row_i_ptr;
+        uint32 y_next = (row + 1 < rows) ? image->stride : 0;
+        planes_t row_planes = planes_at_row(planes, image, row);
+
+        for (uint32 col = 0; col < image->width; col+=2) {
+            uint32 next = (col + 1 < image->width) ? 3 : 0;
+            downsample_pixel_fixed(row_i_ptr + col * 3, row_j_ptr + col * 3, next, downsampled_pixel);
+            store_planar_pixel(downsampled_pixel, &row_planes, y_next, col, image->width);
+        }
+    }
+}
+
+
+void downsample422_rows_scalar(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows){
+    uint32 row_size = image->stride * 3;
+
+    for (uint32 row = 0; row < rows; ++row) {
+        const uint8* row_ptr = ycbcr + (size_t) row * row_size;
+        uint8* subsampled_row = subsampled_ycbcr + row * SUBSAMPLED_ROW_SIZE(image, 2, 1);
+
+        for (uint32 col = 0; col < image->width; col+=2) {
+            uint32 next = (col + 1 < image->width) ? 3 : 0;
+            downsample422_pixel_fixed(row_ptr + col * 3, next, subsampled_row + col * 2);
+        }
+    }
+}
+
+
+void downsample411_rows_scalar(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows){
+    uint32 row_size = image->stride * 3;
+
+    for (uint32 row = 0; row < rows; ++row) {
+        const uint8* row_ptr = ycbcr + (size_t) row * row_size;
+        uint8* subsampled_row = subsampled_ycbcr + row * SUBSAMPLED_ROW_SIZE(image, 4, 1);
+
+        for (uint32 col = 0; col < image->width; col+=4) {
+            downsample411_pixel_fixed(row_ptr, col, image->width, subsampled_row + (col / 4) * 6);
+        }
+    }
+}
+
+
+void downsample420_cosited_rows_scalar(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 first_row, uint32 rows){
+    uint32 row_size = image->stride * 3;
+
+    for (uint32 row = first_row; row < first_row + rows; row+=2) {
+        const uint8* row_i_ptr = ycbcr + (size_t) row * row_size;
+        // the first and the odd last row of the frame repeat row_i
+        const uint8* above = (row > 0) ? row_i_ptr - row_size : row_i_ptr;
+        const uint8* row_j_ptr = (row + 1 < image->height) ? row_i_ptr + row_size : row_i_ptr;
+        uint8* downsampled_row = downsampled_ycbcr + (row / 2) * DOWNSAMPLED_ROW_SIZE(image);
+
+        for (uint32 col = 0; col < image->width; col+=2) {
+            downsample420_cosited_pixel_fixed(above, row_i_ptr, row_j_ptr, col, image->width, downsampled_row + col * 3);
+        }
+    }
+}
+
+
+void halve_rows_scalar(const uint32* raster, uint32* half, const image_t* image, uint32 half_stride, uint32 rows){
+    for (uint32 row = 0; row < rows; row+=2) {
+        const uint8* row_i_ptr = (const uint8*) (raster + (size_t) row * image->stride);
+        // odd heights repeat the last row
+        const uint8* row_j_ptr = (row + 1 < rows) ? row_i_ptr + (size_t) image->stride * 4 : row_i_ptr;
+        uint32* half_row = half + (size_t) (row / 2) * half_stride;
+
+        for (uint32 col = 0; col < image->width; col+=2) {
+            uint32 next = (col + 1 < image->width) ? 4 : 0;
+            halve_pixel_fixed(row_i_ptr + col * 4, row_j_ptr + col * 4, next, (uint8*) (half_row + col / 2));
+        }
+    }
+}
+
+
+void compare_samples_scalar(const uint8* reference, const uint8* samples, uint32 n, sample_error_t* error){
+    for (uint32 i = 0; i < n; ++i) {
+        add_sample_error(reference[i], samples[i], error);
+    }
+}
+
+
+static inline uint8 round_sample(double sample){
+    return (uint8) (sample <= 0 ? 0 : sample >= 255 ? 255 : sample + 0.5);
+}
+
+// Floating-point reference of the inverse conversion, same chroma positions and weights as rgb420_pixel_fixed
+void convert_ycbcr420_to_rgb_into(const uint8* downsampled_ycbcr, uint32* raster, const image_t* image, upsample_t filter){
+    reference_coefficients_t c = reference_coefficients();
+    size_t row_size = DOWNSAMPLED_ROW_SIZE(image);
+
+    for (uint32 row = 0; row < image->height; ++row) {
+        for (uint32 col = 0; col < image->width; ++col) {
+            const uint8* pixel = downsampled_ycbcr + (row / 2) * row_size + (col / 2) * 6;
+            double cb = pixel[4], cr = pixel[5];
+
+            if (filter == UPSAMPLE_BILINEAR) {
+                // the other macro-pixel row/column is the one on the side of the pixel, or the edge itself
+                const uint8* far_row = pixel;
+                int32 far_col = 0;
+                if (row & 1) {
+                    far_row = (row + 1 < image->height) ? pixel + row_size : pixel;
+                } else if (row > 0) {
+                    far_row = pixel - row_size;
+                }
+                if (col & 1) {
+                    far_col = (col + 1 < image->width) ? 6 : 0;
+                } else if (col > 0) {
+                    far_col = -6;
+                }
+                cb = (9.0 * pixel[4] + 3.0 * far_row[4] + 3.0 * pixel[far_col + 4] + far_row[far_col + 4]) / 16;
+                cr = (9.0 * pixel[5] + 3.0 * far_row[5] + 3.0 * pixel[far_col + 5] + far_row[far_col + 5]) / 16;
+            }
+
+            double y = c.inverse_y * (pixel[(row & 1) * 2 + (col & 1)] - c.y_offset);
+            uint8* rgba = (uint8*) (raster + (size_t) row * image->stride + col);
+            rgba[0] = round_sample(y + c.inverse_cr_r * (cr - 128));
+            rgba[1] = round_sample(y - c.inverse_cb_g * (cb - 128) - c.inverse_cr_g * (cr - 128));
+            rgba[2] = round_sample(y + c.inverse_cb_b * (cb - 128));
+            rgba[3] = 255;
+        }
+    }
+}
+
+
+#ifdef __ARM_NEON
+//SIMD approach to the 2 rows at a time technique
+void downsample_rows_neon(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 rows){
+    uint32 row_size = image->stride * 3;
+    // 16 pixel blocks only ever cover whole 2x2 macro-pixels, an odd last column is done in scalar
+    uint32 even_width = image->width & ~1u;
+    uint32 vector_width = even_width >= 16 ? even_width : 0;
+    uint8x16x3_t row_i, row_j;
+    uint8x16_t row_i_cb_cr_even, row_i_cb_cr_odd, row_j_cb_cr_even, row_j_cb_cr_odd, row_i_cb_cr_avg, row_j_cb_cr_avg, cb_cr_avg;
+    uint16x8x3_t values;
+
+    for (uint32 row = 0; row < rows; row+=2) {
+        const uint8* row_i_ptr = ycbcr + (size_t) row * row_size;
+        // odd heights repeat the last row
+        const uint8* row_j_ptr = (row + 1 < rows) ? row_i_ptr + row_size : row_i_ptr;
+        uint8* downsampled_row = downsampled_ycbcr + (row / 2) * DOWNSAMPLED_ROW_SIZE(image);
+
+        for (uint32 col = 0; col < vector_width; col+=16) {
+            // the last block is shifted back to overlap the previous one instead of running a scalar tail
+            uint32 idx = (col + 16 > vector_width) ? (vector_width - 16) * 3 : col * 3;
+
+            // load row_i and row_i+1
+            row_i = vld3q_u8(row_i_ptr+idx);
+            row_j = vld3q_u8(row_j_ptr+idx);
+
+            // interleve cb/cr
+            row_i_cb_cr_even = vtrn1q_u8(row_i.val[1], row_i.val[2]);
+            row_i_cb_cr_odd = vtrn2q_u8(row_i.val[1], row_i.val[2]);
+            row_j_cb_cr_even = vtrn1q_u8(row_j.val[1], row_j.val[2]);
+            row_j_cb_cr_odd = vtrn2q_u8(row_j.val[1], row_j.val[2]);
+
+            // avg
+            row_i_cb_cr_avg = vrhaddq_u8(row_i_cb_cr_even, row_i_cb_cr_odd);
+            row_j_cb_cr_avg = vrhaddq_u8(row_j_cb_cr_even, row_j_cb_cr_odd);
+            cb_cr_avg = vrhaddq_u8(row_i_cb_cr_avg, row_j_cb_cr_avg);
+
+            // reinterpret to 16x8_3_t vector array
+            values.val[0] = vreinterpretq_u16_u8(row_i.val[0]);
+            values.val[1] = vreinterpretq_u16_u8(row_j.val[0]);
+            values.val[2] = vreinterpretq_u16_u8(cb_cr_avg);
+
+            // store and interleave arrays of 16x8x3_t vector, 16 pixels make 8 macro-pixels of 6 bytes
+            vst3q_u16((uint16*) (downsampled_row + idx), values);
+        }
+
+        for (uint32 col = vector_width; col < image->width; col+=2) {
+            uint32 next = (col + 1 < image->width) ? 3 : 0;
+            downsample_pixel_fixed(row_i_ptr + col * 3, row_j_ptr + col * 3, next, downsampled_row + col * 3);
+        }
+    }
+}
+
+
+// Stores 8 averaged CbCr pairs as they are for NV12, or split into the Cb and Cr planes for I420
+static inline void store_chroma_neon(const planes_t* row_planes, uint32 col, uint8x16_t cb_cr_avg){
+    if (row_planes->cr == NULL) {
+        vst1q_u8(row_planes->cb + col, cb_cr_avg);
+        return;
+    }
+    uint8x8x2_t cb_cr = vuzp_u8(vget_low_u8(cb_cr_avg), vget_high_u8(cb_cr_avg));
+    vst1_u8(row_planes->cb + col / 2, cb_cr.val[0]);
+    vst1_u8(row_planes->cr + col / 2, cb_cr.val[1]);
+}
+
+
+/**
+ * R, G and B of 16 packed pixels: vld4q_u8 for the 4 byte formats with R and B swapped for BGRA,
+ * vld3q_u8 for RGB24 and two vld3q_u16 narrowed like convert48_rows_neon for RGB48.
+ */
+static inline void load_rgb_neon(const uint8* pixels, pixel_format_t format, uint8x16_t* r, uint8x16_t* g, uint8x16_t* b){
+    uint8x16x4_t rgba;
+    uint8x16x3_t rgb;
+    uint16x8x3_t rgb_lo, rgb_hi;
+
+    switch (format) {
+        case PIXEL_RGBA:
+        case PIXEL_BGRA:
+            rgba = vld4q_u8(pixels);
+            *r = rgba.val[format == PIXEL_RGBA ? 0 : 2];
+            *g = rgba.val[1];
+            *b = rgba.val[format == PIXEL_RGBA ? 2 : 0];
+            break;
+        case PIXEL_RGB24:
+            rgb = vld3q_u8(pixels);
+            *r = rgb.val[0];
+            *g = rgb.val[1];
+            *b = rgb.val[2];
+            break;
+        case PIXEL_RGB48:
+            rgb_lo = vld3q_u16((const uint16*) pixels);
+            rgb_hi = vld3q_u16((const uint16*) pixels + 24);
+            *r = vcombine_u8(vqrshrn_n_u16(rgb_lo.val[0], 8), vqrshrn_n_u16(rgb_hi.val[0], 8));
+            *g = vcombine_u8(vqrshrn_n_u16(rgb_lo.val[1], 8), vqrshrn_n_u16(rgb_hi.val[1], 8));
+            *b = vcombine_u8(vqrshrn_n_u16(rgb_lo.val[2], 8), vqrshrn_n_u16(rgb_hi.val[2], 8));
+            break;
+    }
+}
+
+
+// downsample_rows_neon storing Y and chroma straight into their planes instead of macro-pixels
+void downsample_planar_rows_neon(const uint8* ycbcr, const planes_t* planes, const image_t* image, uint32 rows){
+    uint32 row_size = image->stride * 3;
+    uint32 even_width = image->width & ~1u;
+    uint32 vector_width = even_width >= 16 ? even_width : 0;
+    uint8x16x3_t row_i, row_j;
+    uint8x16_t row_i_cb_cr_avg, row_j_cb_cr_avg, cb_cr_avg;
+    uint8 downsampled_pixel[6];
+
+    for (uint32 row = 0; row < rows; row+=2) {
+        const uint8* row_i_ptr = ycbcr + (size_t) row * row_size;
+        // odd heights repeat the last row
+        const uint8* row_j_ptr = (row + 1 < rows) ? row_i_ptr + row_size : row_i_ptr;
+        uint32 y_next = (row + 1 < rows) ? image->stride : 0;
+        planes_t row_planes = planes_at_row(planes, image, row);
+
+        for (uint32 col = 0; col < vector_width; col+=16) {
+            uint32 block = (col + 16 > vector_width) ? vector_width - 16 : col;
+
+            row_i = vld3q_u8(row_i_ptr + block * 3);
+            row_j = vld3q_u8(row_j_ptr + block * 3);
+            row_i_cb_cr_avg = vrhaddq_u8(vtrn1q_u8(row_i.val[1], row_i.val[2]), vtrn2q_u8(row_i.val[1], row_i.val[2]));
+            row_j_cb_cr_avg = vrhaddq_u8(vtrn1q_u8(row_j.val[1], row_j.val[2]), vtrn2q_u8(row_j.val[1], row_j.val[2]));
+            cb_cr_avg = vrhaddq_u8(row_i_cb_cr_avg, row_j_cb_cr_avg);
+
+            vst1q_u8(row_planes.y + block, row_i.val[0]);
+            vst1q_u8(row_planes.y + y_next + block, row_j.val[0]);
+            store_chroma_neon(&row_planes, block, cb_cr_avg);
+        }
+
+        for (uint32 col = vector_width; col < image->width; col+=2) {
+            uint32 next = (col + 1 < image->width) ? 3 : 0;
+            downsample_pixel_fixed(row_i_ptr + col * 3, row_j_ptr + col * 3, next, downsampled_pixel);
+            store_planar_pixel(downsampled_pixel, &row_planes, y_next, col, image->width);
+        }
+    }
+}
+
+
+
+// 16 pixels make 8 Y0Y1CbCr blocks, the Y pairs and the averaged CbCr pairs are stored as 16-bit pairs
+void downsample422_rows_neon(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows){
+    uint32 row_size = image->stride * 3;
+    uint32 even_width = image->width & ~1u;
+    uint32 vector_width = even_width >= 16 ? even_width : 0;
+    uint8x16x3_t pixels;
+    uint16x8x2_t values;
+
+    for (uint32 row = 0; row < rows; ++row) {
+        const uint8* row_ptr = ycbcr + (size_t) row * row_size;
+        uint8* subsampled_row = subsampled_ycbcr + row * SUBSAMPLED_ROW_SIZE(image, 2, 1);
+
+        for (uint32 col = 0; col < vector_width; col+=16) {
+            uint32 block = (col + 16 > vector_width) ? vector_width - 16 : col;
+
+            pixels = vld3q_u8(row_ptr + block * 3);
+            values.val[0] = vreinterpretq_u16_u8(pixels.val[0]);
+            values.val[1] = vreinterpretq_u16_u8(vrhaddq_u8(vtrn1q_u8(pixels.val[1], pixels.val[2]), vtrn2q_u8(pixels.val[1], pixels.val[2])));
+            vst2q_u16((uint16*) (subsampled_row + block * 2), values);
+        }
+
+        if (image->width & 1) {
+            downsample422_pixel_fixed(row_ptr + even_width * 3, 0, subsampled_row + even_width * 2);
+        }
+    }
+}
+
+
+// 16 pixels make 4 Y0Y1Y2Y3CbCr blocks, the CbCr pairs of neighbouring pixel pairs are averaged once more
+void downsample411_rows_neon(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows){
+    uint32 row_size = image->stride * 3;
+    uint32 quad_width = image->width & ~3u;
+    uint32 vector_width = quad_width >= 16 ? quad_width : 0;
+    uint8x16x3_t pixels;
+    uint16x8_t y_pairs, cb_cr_pairs;
+    uint16x4x3_t values;
+
+    for (uint32 row = 0; row < rows; ++row) {
+        const uint8* row_ptr = ycbcr + (size_t) row * row_size;
+        uint8* subsampled_row = subsampled_ycbcr + row * SUBSAMPLED_ROW_SIZE(image, 4, 1);
+
+        for (uint32 col = 0; col < vector_width; col+=16) {
+            uint32 block = (col + 16 > vector_width) ? vector_width - 16 : col;
+
+            pixels = vld3q_u8(row_ptr + block * 3);
+            y_pairs = vreinterpretq_u16_u8(pixels.val[0]);
+            cb_cr_pairs = vreinterpretq_u16_u8(vrhaddq_u8(vtrn1q_u8(pixels.val[1], pixels.val[2]), vtrn2q_u8(pixels.val[1], pixels.val[2])));
+
+            values.val[0] = vget_low_u16(vuzp1q_u16(y_pairs, y_pairs));
+            values.val[1] = vget_low_u16(vuzp2q_u16(y_pairs, y_pairs));
+            values.val[2] = vreinterpret_u16_u8(vrhadd_u8(vreinterpret_u8_u16(vget_low_u16(vuzp1q_u16(cb_cr_pairs, cb_cr_pairs))),
+                                                          vreinterpret_u8_u16(vget_low_u16(vuzp2q_u16(cb_cr_pairs, cb_cr_pairs)))));
+            vst3_u16((uint16*) (subsampled_row + (block / 4) * 6), values);
+        }
+
+        for (uint32 col = vector_width; col < image->width; col+=4) {
+            downsample411_pixel_fixed(row_ptr, col, image->width, subsampled_row + (col / 4) * 6);
+        }
+    }
+}
+
+
+// [1 2 1] sums of the CbCr pairs of the 8 even pixels of the 16 at pixel, 16-bit in the Cb Cr order of vtrn1q_u8
+static inline void chroma_taps_neon(const uint8* pixel, uint16x8_t* low, uint16x8_t* high){
+    uint8x16x3_t pixels = vld3q_u8(pixel);
+    // one pixel earlier, so its even pixels are the left neighbours
+    uint8x16x3_t left_pixels = vld3q_u8(pixel - 3);
+    uint8x16_t even = vtrn1q_u8(pixels.val[1], pixels.val[2]);
+    uint8x16_t odd = vtrn2q_u8(pixels.val[1], pixels.val[2]);
+    uint8x16_t left = vtrn1q_u8(left_pixels.val[1], left_pixels.val[2]);
+
+    *low = vaddq_u16(vaddl_u8(vget_low_u8(left), vget_low_u8(odd)), vshll_n_u8(vget_low_u8(even), 1));
+    *high = vaddq_u16(vaddl_high_u8(left, odd), vshll_high_n_u8(even, 1));
+}
+
+
+/**
+ * Co-sited 4:2:0, see downsample420_cosited_pixel_fixed(). The filter reads the pixel left of each
+ * block, so the vector blocks start at column 2 and the first macro-pixel is done in scalar.
+ */
+void downsample420_cosited_rows_neon(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 first_row, uint32 rows){
+    uint32 row_size = image->stride * 3;
+    uint32 even_width = image->width & ~1u;
+    uint32 vector_width = even_width >= 18 ? even_width : 0;
+    uint16x8_t above_low, above_high, row_i_low, row_i_high, row_j_low, row_j_high;
+    uint8x16_t cb_cr;
+    uint16x8x3_t values;
+
+    for (uint32 row = first_row; row < first_row + rows; row+=2) {
+        const uint8* row_i_ptr = ycbcr + (size_t) row * row_size;
+        // the first and the odd last row of the frame repeat row_i
+        const uint8* above = (row > 0) ? row_i_ptr - row_size : row_i_ptr;
+        const uint8* row_j_ptr = (row + 1 < image->height) ? row_i_ptr + row_size : row_i_ptr;
+        uint8* downsampled_row = downsampled_ycbcr + (row / 2) * DOWNSAMPLED_ROW_SIZE(image);
+
+        downsample420_cosited_pixel_fixed(above, row_i_ptr, row_j_ptr, 0, image->width, downsampled_row);
+        for (uint32 col = 2; col < vector_width; col+=16) {
+            uint32 block = (col + 16 > vector_width) ? vector_width - 16 : col;
+
+            chroma_taps_neon(above + block * 3, &above_low, &above_high);
+            chroma_taps_neon(row_i_ptr + block * 3, &row_i_low, &row_i_high);
+            chroma_taps_neon(row_j_ptr + block * 3, &row_j_low, &row_j_high);
+            cb_cr = vcombine_u8(vrshrn_n_u16(vaddq_u16(vaddq_u16(above_low, row_j_low), vshlq_n_u16(row_i_low, 1)), 4),
+                                vrshrn_n_u16(vaddq_u16(vaddq_u16(above_high, row_j_high), vshlq_n_u16(row_i_high, 1)), 4));
+
+            values.val[0] = vreinterpretq_u16_u8(vld3q_u8(row_i_ptr + block * 3).val[0]);
+            values.val[1] = vreinterpretq_u16_u8(vld3q_u8(row_j_ptr + block * 3).val[0]);
+            values.val[2] = vreinterpretq_u16_u8(cb_cr);
+            vst3q_u16((uint16*) (downsampled_row + block * 3), values);
+        }
+
+        for (uint32 col = vector_width > 0 ? vector_width : 2; col < image->width; col+=2) {
+            downsample420_cosited_pixel_fixed(above, row_i_ptr, row_j_ptr, col, image->width, downsampled_row + col * 3);
+        }
+    }
+}
+
+// Bilinear Cb/Cr of the 16 pixels of the 8 macro-pixels at near, far is the same block one row away
+static inline void bilinear_chroma_neon(const uint8* near, const uint8* far, uint16x8_t* cb, uint16x8_t* cr){
+    uint16x8_t three = vdupq_n_u16(3);
+    uint16x8_t cb_columns[3], cr_columns[3];
+
+    // 3 * near + far for the left neighbour, the macro-pixel itself and the right neighbour
+    for (int column = 0; column < 3; ++column) {
+        uint16x8_t near_cb_cr = vld3q_u16((const uint16*) (near + (column - 1) * 6)).val[2];
+        uint16x8_t far_cb_cr = vld3q_u16((const uint16*) (far + (column - 1) * 6)).val[2];
+        cb_columns[column] = vmlaq_u16(vandq_u16(far_cb_cr, vdupq_n_u16(0xff)), vandq_u16(near_cb_cr, vdupq_n_u16(0xff)), three);
+        cr_columns[column] = vmlaq_u16(vshrq_n_u16(far_cb_cr, 8), vshrq_n_u16(near_cb_cr, 8), three);
+    }
+
+    // the even pixel weighs in its left neighbour, the odd one its right neighbour
+    uint16x8_t cb_even = vrshrq_n_u16(vmlaq_u16(cb_columns[0], cb_columns[1], three), 4);
+    uint16x8_t cb_odd = vrshrq_n_u16(vmlaq_u16(cb_columns[2], cb_columns[1], three), 4);
+    uint16x8_t cr_even = vrshrq_n_u16(vmlaq_u16(cr_columns[0], cr_columns[1], three), 4);
+    uint16x8_t cr_odd = vrshrq_n_u16(vmlaq_u16(cr_columns[2], cr_columns[1], three), 4);
+
+    cb[0] = vzip1q_u16(cb_even, cb_odd);
+    cb[1] = vzip2q_u16(cb_even, cb_odd);
+    cr[0] = vzip1q_u16(cr_even, cr_odd);
+    cr[1] = vzip2q_u16(cr_even, cr_odd);
+}
+
+
+// 8 pixels make 4, vld2q_u32 splits them into the even and odd ones which are averaged like the chroma of downsample_rows_neon
+void halve_rows_neon(const uint32* raster, uint32* half, const image_t* image, uint32 half_stride, uint32 rows){
+    uint32 even_width = image->width & ~1u;
+    uint32 vector_width = even_width >= 8 ? even_width : 0;
+
+    for (uint32 row = 0; row < rows; row+=2) {
+        const uint32* row_i_ptr = raster + (size_t) row * image->stride;
+        // odd heights repeat the last row
+        const uint32* row_j_ptr = (row + 1 < rows) ? row_i_ptr + image->stride : row_i_ptr;
+        uint32* half_row = half + (size_t) (row / 2) * half_stride;
+
+        for (uint32 col = 0; col < vector_width; col+=8) {
+            uint32 block = (col + 8 > vector_width) ? vector_width - 8 : col;
+            uint32x4x2_t row_i = vld2q_u32(row_i_ptr + block);
+            uint32x4x2_t row_j = vld2q_u32(row_j_ptr + block);
+            uint8x16_t row_i_avg = vrhaddq_u8(vreinterpretq_u8_u32(row_i.val[0]), vreinterpretq_u8_u32(row_i.val[1]));
+            uint8x16_t row_j_avg = vrhaddq_u8(vreinterpretq_u8_u32(row_j.val[0]), vreinterpretq_u8_u32(row_j.val[1]));
+
+            vst1q_u32(half_row + block / 2, vreinterpretq_u32_u8(vrhaddq_u8(row_i_avg, row_j_avg)));
+        }
+
+        for (uint32 col = vector_width; col < image->width; col+=2) {
+            uint32 next = (col + 1 < image->width) ? 4 : 0;
+            halve_pixel_fixed((const uint8*) (row_i_ptr + col), (const uint8*) (row_j_ptr + col), next, (uint8*) (half_row + col / 2));
+        }
+    }
+}
+
+
+/**
+ * Sum of squared differences, largest difference and error histogram of n sample pairs, 16 at a time.
+ * The histogram counts the differences of at least 1, 2, 3, 4, 8, 16 and 32 and the bins are taken
+ * apart at the end; the last partial block goes through add_sample_error().
+ */
+void compare_samples_neon(const uint8* reference, const uint8* samples, uint32 n, sample_error_t* error){
+    static const uint8 bin_starts[ERROR_BINS - 1] = {1, 2, 3, 4, 8, 16, 32};
+    uint32 vector_n = n - n % 16;
+    uint64x2_t sum_squares = vdupq_n_u64(0);
+    uint8x16_t max_error = vdupq_n_u8(0);
+    uint32x4_t at_least[ERROR_BINS - 1];
+    uint64 counts[ERROR_BINS];
+
+    for (int bin = 0; bin < ERROR_BINS - 1; ++bin) {
+        at_least[bin] = vdupq_n_u32(0);
+    }
+
+    for (uint32 i = 0; i < vector_n; i+=16) {
+        uint8x16_t difference = vabdq_u8(vld1q_u8(reference + i), vld1q_u8(samples + i));
+        uint16x8_t low = vmull_u8(vget_low_u8(difference), vget_low_u8(difference));
+        uint16x8_t high = vmull_high_u8(difference, difference);
+
+        sum_squares = vpadalq_u32(sum_squares, vaddq_u32(vpaddlq_u16(low), vpaddlq_u16(high)));
+        max_error = vmaxq_u8(max_error, difference);
+        for (int bin = 0; bin < ERROR_BINS - 1; ++bin) {
+            uint8x16_t past = vshrq_n_u8(vcgeq_u8(difference, vdupq_n_u8(bin_starts[bin])), 7);
+            at_least[bin] = vpadalq_u16(at_least[bin], vpaddlq_u8(past));
+        }
+    }
+
+    error->sum_squares += vaddvq_u64(sum_squares);
+    error->max_error = vmaxvq_u8(max_error) > error->max_error ? vmaxvq_u8(max_error) : error->max_error;
+    counts[0] = vector_n;
+    for (int bin = 0; bin < ERROR_BINS - 1; ++bin) {
+        counts[bin + 1] = vaddlvq_u32(at_least[bin]);
+    }
+    for (int bin = 0; bin < ERROR_BINS; ++bin) {
+        error->histogram[bin] += counts[bin] - (bin + 1 < ERROR_BINS ? counts[bin + 1] : 0);
+    }
+    error->samples += vector_n;
+
+    for (uint32 i = vector_n; i < n; ++i) {
+        add_sample_error(reference[i], samples[i], error);
+    }
+}
+#endif
+
+
+/**
+ * Lookup tables of the scalar kernels, one entry per sample value and channel with the channel's share
+ * of Y, Cb and Cr packed in 16-bit fields at bits 0, 16 and 32. Each share is kept non-negative by
+ * flipping the subtracted terms to c * (255 - x) and moving the constants into the red entries, so the
+ * sum of the three entries of a pixel holds the exact Y << 8, Cb << 8 and Cr << 8 of
+ * convert_pixel_fixed() without a carry between fields. Entry 256 repeats 255 for the rounded high
+ * byte of 16-bit samples, see narrow_sample(); 3 x 257 x 8 bytes stays well inside L1.
+ */
+#define LUT_REPEAT_4(entry, i) entry(i) entry(i + 1) entry(i + 2) entry(i + 3)
+#define LUT_REPEAT_16(entry, i) LUT_REPEAT_4(entry, i) LUT_REPEAT_4(entry, i + 4) LUT_REPEAT_4(entry, i + 8) LUT_REPEAT_4(entry, i + 12)
+#define LUT_REPEAT_64(entry, i) LUT_REPEAT_16(entry, i) LUT_REPEAT_16(entry, i + 16) LUT_REPEAT_16(entry, i + 32) LUT_REPEAT_16(entry, i + 48)
+#define LUT_REPEAT_256(entry, i) LUT_REPEAT_64(entry, i) LUT_REPEAT_64(entry, i + 64) LUT_REPEAT_64(entry, i + 128) LUT_REPEAT_64(entry, i + 192)
+#define LUT_ENTRIES(entry) {LUT_REPEAT_256(entry, 0) entry(256)}
+#define LUT_SAMPLE(i) ((i) > 255 ? 255 : (i))
+#define LUT_FIELDS(y, cb, cr) ((uint64) (y) | (uint64) (cb) << 16 | (uint64) (cr) << 32),
+#define LUT_RED(i) LUT_FIELDS(Y_R * LUT_SAMPLE(i) + (Y_OFFSET << 8), CB_R * (255 - LUT_SAMPLE(i)) + 32768 - (CB_R + CB_G) * 255, \
+                              CR_R * LUT_SAMPLE(i) + 32768 - (CR_G + CR_B) * 255)
+#define LUT_GREEN(i) LUT_FIELDS(Y_G * LUT_SAMPLE(i), CB_G * (255 - LUT_SAMPLE(i)), CR_G * (255 - LUT_SAMPLE(i)))
+#define LUT_BLUE(i) LUT_FIELDS(Y_B * LUT_SAMPLE(i), CB_B * LUT_SAMPLE(i), CR_B * (255 - LUT_SAMPLE(i)))
+#define LUT_SIZE 257
+
+// Every kernel depending on the color matrix, once per color space
+#define COLOR_TEMPLATE "conversion_color.inc"
+#include "color_spaces.inc"
+#undef COLOR_TEMPLATE
+
+
+/*
+ * SIMD kernels through the kernel table, NEON on ARM and SSE4.1/AVX2/AVX-512 on x86 depending on the CPU
+ */
+void convert_rgb_to_ycbcr_v3_into(const uint32* raster, uint8* ycbcr, const image_t* image){
+    kernels->convert(raster, ycbcr, image, image->height);
+}
+
+
+void convert_rgb48_to_ycbcr_simd_into(const uint16* rgb, uint8* ycbcr, const image_t* image){
+    kernels->convert48(rgb, ycbcr, image, image->height);
+}
+
+
+/*
+ * Lookup table kernels of the scalar tables, to compare with the fixed-point versions on any build
+ */
+void convert_rgb_to_ycbcr_lut_into(const uint32* raster, uint8* ycbcr, const image_t* image){
+    scalar_kernels[COLOR_SPACE_INDEX(&color_space)].convert(raster, ycbcr, image, image->height);
+}
+
+
+void convert_rgb48_to_ycbcr_lut_into(const uint16* rgb, uint8* ycbcr, const image_t* image){
+    scalar_kernels[COLOR_SPACE_INDEX(&color_space)].convert48(rgb, ycbcr, image, image->height);
+}
+
+
+// 16-bit samples all the way to the rounded 8-bit outputs, see convert48_pixel_precise()
+void convert_rgb48_to_ycbcr_precise_into(const uint16* rgb, uint8* ycbcr, const image_t* image){
+    kernels->convert48_precise(rgb, ycbcr, image, image->height);
+}
+
+
+void downsample_ycbcr_simd_into(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image){
+    kernels->downsample(ycbcr, downsampled_ycbcr, image, image->height);
+}
+
+
+void downsample_ycbcr_422_simd_into(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image){
+    kernels->downsample422(ycbcr, subsampled_ycbcr, image, image->height);
+}
+
+
+void downsample_ycbcr_411_simd_into(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image){
+    kernels->downsample411(ycbcr, subsampled_ycbcr, image, image->height);
+}
+
+
+void downsample_ycbcr_cosited_simd_into(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image){
+    kernels->downsample420_cosited(ycbcr, downsampled_ycbcr, image, 0, image->height);
+}
+
+
+// 4:4:4 output is the YCbCr frame itself, only a caller that wants it in its own buffer needs the copy
+void downsample_ycbcr_444_into(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image){
+    memcpy(subsampled_ycbcr, ycbcr, YCBCR_FRAME_SIZE(image));
+}
+
+
+void subsample_ycbcr_simd_into(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, subsampling_t subsampling){
+    switch (subsampling) {
+        case SUBSAMPLING_422:
+            downsample_ycbcr_422_simd_into(ycbcr, subsampled_ycbcr, image);
+            break;
+        case SUBSAMPLING_411:
+            downsample_ycbcr_411_simd_into(ycbcr, subsampled_ycbcr, image);
+            break;
+        case SUBSAMPLING_444:
+            downsample_ycbcr_444_into(ycbcr, subsampled_ycbcr, image);
+            break;
+        case SUBSAMPLING_420_COSITED:
+            downsample_ycbcr_cosited_simd_into(ycbcr, subsampled_ycbcr, image);
+            break;
+        default:
+            downsample_ycbcr_simd_into(ycbcr, subsampled_ycbcr, image);
+    }
+}
+
+
+void convert_rgb_to_subsampled_into(const uint32* raster, uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, subsampling_t subsampling,
+                                    bool two_stage){
+    if (!subsampling_via_ycbcr(subsampling, two_stage)) {
+        if (subsampling == SUBSAMPLING_444) {
+            kernels->convert(raster, subsampled_ycbcr, image, image->height);
+        } else {
+            kernels->convert420(raster, subsampled_ycbcr, image, image->height);
+        }
+        return;
+    }
+    kernels->convert(raster, ycbcr, image, image->height);
+    subsample_ycbcr_simd_into(ycbcr, subsampled_ycbcr, image, subsampling);
+}
+
+
+void convert_rgb_to_ycbcr420_simd_into(const uint32* raster, uint8* downsampled_ycbcr, const image_t* image){
+    kernels->convert420(raster, downsampled_ycbcr, image, image->height);
+}
+
+
+void downsample_ycbcr_i420_simd_into(const uint8* ycbcr, uint8* frame, const image_t* image){
+    planes_t planes = frame_planes(frame, image, LAYOUT_I420);
+    kernels->downsample_planar(ycbcr, &planes, image, image->height);
+}
+
+
+void downsample_ycbcr_nv12_simd_into(const uint8* ycbcr, uint8* frame, const image_t* image){
+    planes_t planes = frame_planes(frame, image, LAYOUT_NV12);
+    kernels->downsample_planar(ycbcr, &planes, image, image->height);
+}
+
+
+void convert_rgb_to_i420_simd_into(const uint32* raster, uint8* frame, const image_t* image){
+    planes_t planes = frame_planes(frame, image, LAYOUT_I420);
+    kernels->convert420_planar(raster, &planes, image, image->height);
+}
+
+
+void convert_rgb_to_nv12_simd_into(const uint32* raster, uint8* frame, const image_t* image){
+    planes_t planes = frame_planes(frame, image, LAYOUT_NV12);
+    kernels->convert420_planar(raster, &planes, image, image->height);
+}
+
+
+void convert_packed_to_ycbcr_simd_into(const uint8* pixels, pixel_format_t format, uint8* ycbcr, const image_t* image){
+    kernels->convert_packed(pixels, format, ycbcr, image, image->height);
+}
+
+
+void convert_packed_to_i420_simd_into(const uint8* pixels, pixel_format_t format, uint8* frame, const image_t* image){
+    planes_t planes = frame_planes(frame, image, LAYOUT_I420);
+    kernels->convert420_planar_packed(pixels, format, &planes, image, image->height);
+}
+
+
+void convert_ycbcr420_to_rgb_simd_into(const uint8* downsampled_ycbcr, uint32* raster, const image_t* image, upsample_t filter){
+    kernels->convert420_to_rgb(downsampled_ycbcr, raster, image, 0, image->height, filter);
+}
+
+
+/**
+ * Clamps the levels to MAX_PROXY_LEVELS and cuts the strips into at most `bands` bands, whose scratch
+ * is allocated here in one piece rather than by each band. Returns the number of strips, 0 without levels.
+ */
+static uint32 proxy_data_init(proxy_worker_data_t* data, uint32 levels, uint32 bands){
+    data->levels = levels < MAX_PROXY_LEVELS ? levels : MAX_PROXY_LEVELS;
+    data->scratch = NULL;
+    data->scratch_pixels = 0;
+    data->band_strips = 2;
+    if (data->levels == 0) {
+        return 0;
+    }
+
+    uint32 strip_rows = 2u << data->levels;
+    uint32 strips = (data->image->height + strip_rows - 1) / strip_rows;
+    bands = bands < strips ? bands : strips;
+    // bands are even numbers of strips, as the pool hands them out
+    data->band_strips = ((strips + bands - 1) / bands + 1) & ~1u;
+    for (uint32 level = 1; level <= data->levels; ++level) {
+        data->scratch_pixels += (size_t) proxy_image(data->image, level).width * (strip_rows >> level);
+    }
+    // whole cache lines, so neighbouring bands never share one
+    data->scratch_pixels = (data->scratch_pixels + CACHELINE_SZ / sizeof(uint32) - 1) & ~(CACHELINE_SZ / sizeof(uint32) - 1);
+    data->scratch = (uint32*) frame_alloc(data->scratch_pixels * ((strips + data->band_strips - 1) / data->band_strips) * sizeof(uint32));
+    if (data->scratch == NULL) {
+        printf("[-] \033[0;31mCould not allocate the proxy scratch\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+    return strips;
+}
+
+
+/**
+ * Proxies of the strips [first_strip, first_strip + strips). The halved rows of every level live in
+ * the scratch of the band, a strip per level and a few hundred KB at 8K, and each level is converted
+ * from there before the next strip overwrites it.
+ */
+static void convert_proxy_strips(const proxy_worker_data_t* data, uint32 first_strip, uint32 strips){
+    const image_t* image = data->image;
+    uint32 strip_rows = 2u << data->levels;
+    uint32* halves[MAX_PROXY_LEVELS + 1];
+
+    halves[1] = data->scratch + (size_t) (first_strip / data->band_strips) * data->scratch_pixels;
+    for (uint32 level = 1; level < data->levels; ++level) {
+        halves[level + 1] = halves[level] + (size_t) proxy_image(image, level).width * (strip_rows >> level);
+    }
+
+    for (uint32 strip = first_strip; strip < first_strip + strips; ++strip) {
+        uint32 first_row = strip * strip_rows;
+        uint32 rows = (first_row + strip_rows > image->height) ? image->height - first_row : strip_rows;
+        const uint32* source = data->raster + (size_t) first_row * image->stride;
+        image_t source_image = *image;
+
+        for (uint32 level = 1; level <= data->levels; ++level) {
+            image_t proxy = proxy_image(image, level);
+
+            kernels->halve(source, halves[level], &source_image, proxy.stride, rows);
+            // strips of 2^(levels + 1) rows keep first_row even down to the last level, as the 4:2:0 bands need
+            first_row /= 2;
+            rows = (rows + 1) / 2;
+            if (data->i420) {
+                planes_t planes = frame_planes(data->proxies[level - 1], &proxy, LAYOUT_I420);
+                planes_t band_planes = planes_at_row(&planes, &proxy, first_row);
+                kernels->convert420_planar(halves[level], &band_planes, &proxy, rows);
+            } else {
+                kernels->convert(halves[level], data->proxies[level - 1] + (size_t) first_row * proxy.stride * 3, &proxy, rows);
+            }
+            source = halves[level];
+            source_image = proxy;
+        }
+    }
+}
+
+
+void convert_rgb_to_proxies_simd_into(const uint32* raster, uint8* const* proxies, uint32 levels, bool i420, const image_t* image){
+    proxy_worker_data_t data = {.raster = raster, .proxies = proxies, .i420 = i420, .image = image};
+    uint32 strips = proxy_data_init(&data, levels, 1);
+
+    if (strips > 0) {
+        convert_proxy_strips(&data, 0, strips);
+    }
+    free(data.scratch);
+}
+
+
+// Two-stage reference for the fused kernel: full 4:4:4 frame, then 2x2 chroma averaging
+void convert_rgb_to_ycbcr420_two_stage_into(const uint32* raster, uint8* downsampled_ycbcr, const image_t* image){
+    uint8* ycbcr = frame_alloc(YCBCR_FRAME_SIZE(image));
+    if (ycbcr == NULL) {
+        printf("[-] \033[0;31mCould not allocate the 4:4:4 frame\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+    convert_rgb_to_ycbcr_v3_into(raster, ycbcr, image);
+    downsample_ycbcr_simd_into(ycbcr, downsampled_ycbcr, image);
+    free(ycbcr);
+}
+
+
+/*
+ * Multithreaded kernels, the frame is cut into row bands that the workers of the default pool claim
+ */
+static void convert_band(void* args, uint32 first_row, uint32 rows){
+    worker_data_t* workerData = (worker_data_t*) args;
+    const image_t* image = workerData->image;
+    kernels->convert((const uint32*) workerData->frame + (size_t) first_row * image->stride,
+                     workerData->conv_frame + (size_t) first_row * image->stride * 3, image, rows);
+}
+
+
+static void downsample_band(void* args, uint32 first_row, uint32 rows){
+    worker_data_t* workerData = (worker_data_t*) args;
+    const image_t* image = workerData->image;
+    kernels->downsample((const uint8*) workerData->frame + (size_t) first_row * image->stride * 3,
+                        workerData->conv_frame + (first_row / 2) * DOWNSAMPLED_ROW_SIZE(image), image, rows);
+}
+
+
+static void convert420_band(void* args, uint32 first_row, uint32 rows){
+    worker_data_t* workerData = (worker_data_t*) args;
+    const image_t* image = workerData->image;
+    kernels->convert420((const uint32*) workerData->frame + (size_t) first_row * image->stride,
+                        workerData->conv_frame + (first_row / 2) * DOWNSAMPLED_ROW_SIZE(image), image, rows);
+}
+
+
+static void convert420_planar_band(void* args, uint32 first_row, uint32 rows){
+    planar_worker_data_t* workerData = (planar_worker_data_t*) args;
+    const image_t* image = workerData->image;
+    planes_t planes = planes_at_row(&workerData->planes, image, first_row);
+    kernels->convert420_planar(workerData->raster + (size_t) first_row * image->stride, &planes, image, rows);
+}
+
+
+static void convert420_to_rgb_band(void* args, uint32 first_row, uint32 rows){
+    rgb_worker_data_t* workerData = (rgb_worker_data_t*) args;
+    kernels->convert420_to_rgb(workerData->downsampled_ycbcr, workerData->raster, workerData->image, first_row, rows, workerData->filter);
+}
+
+
+// The bands of the proxies are counted in strips rather than rows
+static void proxy_band(void* args, uint32 first_strip, uint32 strips){
+    convert_proxy_strips((const proxy_worker_data_t*) args, first_strip, strips);
+}
+
+
+void convert_rgb_to_ycbcr_v4_into(const uint32* raster, uint8* ycbcr, const image_t* image){
+    worker_data_t workerData = {raster, ycbcr, image};
+
+    thread_pool_run(thread_pool_default(), convert_band, &workerData, image->height, 0);
+}
+
+
+void downsample_ycbcr_v4_into(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image){
+    worker_data_t workerData = {ycbcr, downsampled_ycbcr, image};
+
+    thread_pool_run(thread_pool_default(), downsample_band, &workerData, image->height, 0);
+}
+
+
+void convert_rgb_to_ycbcr420_v4_into(const uint32* raster, uint8* downsampled_ycbcr, const image_t* image){
+    worker_data_t workerData = {raster, downsampled_ycbcr, image};
+
+    thread_pool_run(thread_pool_default(), convert420_band, &workerData, image->height, 0);
+}
+
+
+void convert_rgb_to_i420_v4_into(const uint32* raster, uint8* frame, const image_t* image){
+    planar_worker_data_t workerData = {raster, frame_planes(frame, image, LAYOUT_I420), image};
+
+    thread_pool_run(thread_pool_default(), convert420_planar_band, &workerData, image->height, 0);
+}
+
+
+void convert_rgb_to_nv12_v4_into(const uint32* raster, uint8* frame, const image_t* image){
+    planar_worker_data_t workerData = {raster, frame_planes(frame, image, LAYOUT_NV12), image};
+
+    thread_pool_run(thread_pool_default(), convert420_planar_band, &workerData, image->height, 0);
+}
+
+
+void convert_ycbcr420_to_rgb_v4_into(const uint8* downsampled_ycbcr, uint32* raster, const image_t* image, upsample_t filter){
+    rgb_worker_data_t workerData = {downsampled_ycbcr, raster, image, filter};
+
+    thread_pool_run(thread_pool_default(), convert420_to_rgb_band, &workerData, image->height, 0);
+}
+
+
+void convert_rgb_to_proxies_v4_into(const uint32* raster, uint8* const* proxies, uint32 levels, bool i420, const image_t* image){
+    thread_pool_t* pool = thread_pool_default();
+    proxy_worker_data_t workerData = {.raster = raster, .proxies = proxies, .i420 = i420, .image = image};
+    // a band per thread, each with its own scratch
+    uint32 strips = proxy_data_init(&workerData, levels, (uint32) thread_pool_size(pool));
+
+    thread_pool_run(pool, proxy_band, &workerData, strips, workerData.band_strips);
+    free(workerData.scratch);
+}
+
+
+/*
+ * Allocating versions of every kernel, they return a new cache-line aligned frame the caller frees
+ */
+#define ALLOCATING_KERNEL(name, input_type, frame_size) \
+uint8* name(const input_type* input, const image_t* image){ \
+    uint8* output = frame_alloc(frame_size(image)); \
+    if (output == NULL) { \
+        printf("[-] \033[0;31mCould not allocate a %ux%u frame\033[0m\n", image->width, image->height); \
+        exit(EXIT_FAILURE); \
+    } \
+    name##_into(input, output, image); \
+    return output; \
+}
+
+ALLOCATING_KERNEL(downsample_ycbcr, uint8, DOWNSAMPLED_FRAME_SIZE)
+ALLOCATING_KERNEL(downsample_ycbcr_v1, uint8, DOWNSAMPLED_FRAME_SIZE)
+ALLOCATING_KERNEL(downsample_ycbcr_v2, uint8, DOWNSAMPLED_FRAME_SIZE)
+ALLOCATING_KERNEL(downsample_ycbcr_simd, uint8, DOWNSAMPLED_FRAME_SIZE)
+ALLOCATING_KERNEL(downsample_ycbcr_v4, uint8, DOWNSAMPLED_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb_to_ycbcr, uint32, YCBCR_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb_to_ycbcr_v1, uint32, YCBCR_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb_to_ycbcr_v2, uint32, YCBCR_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb_to_ycbcr_v2_5, uint32, YCBCR_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb_to_ycbcr_v3, uint32, YCBCR_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb_to_ycbcr_v4, uint32, YCBCR_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb_to_ycbcr_lut, uint32, YCBCR_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb48_to_ycbcr_v1, uint16, YCBCR_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb48_to_ycbcr_simd, uint16, YCBCR_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb48_to_ycbcr_lut, uint16, YCBCR_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb48_to_ycbcr_precise, uint16, YCBCR_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb_to_ycbcr420_simd, uint32, DOWNSAMPLED_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb_to_ycbcr420_two_stage, uint32, DOWNSAMPLED_FRAME_SIZE)
+ALLOCATING_KERNEL(convert_rgb_to_ycbcr420_v4, uint32, DOWNSAMPLED_FRAME_SIZE)
+
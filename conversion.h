@@ -0,0 +1,726 @@
+#ifndef COLOR_SPACE_CONVERSION_H
+#define COLOR_SPACE_CONVERSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <tiffio.h>
+
+#ifdef DEBUG
+#define DEBUG_PRINT(fmt, args...)    fprintf(stderr, fmt, args)
+#else
+#define DEBUG_PRINT(fmt, args...)
+#endif
+
+#define Y(var, i, offset, position) var[i*offset]
+#define Cb(var, i, offset, position) var[i*offset+position]
+#define Cr(var, i, offset, position) var[i*offset+position]
+#define CACHELINE_SZ 64
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ARCH_X86
+#endif
+// SCALAR_ONLY builds leave the x86 kernels out too, to measure the scalar kernels as on a core without a vector unit
+#if defined(ARCH_X86) && !defined(SCALAR_ONLY)
+#define X86_KERNELS
+#endif
+
+/**
+ * Frame geometry shared by every kernel. stride is the number of pixels between the start of two
+ * consecutive rows and is >= width, so padded frames can be processed in place. The same stride is
+ * used for the RGBA raster (4 bytes per pixel) and the 4:4:4 YCbCr frame (3 bytes per pixel).
+ * channels is the number of interleaved samples per pixel of a 16-bit source (3 = RGB, 4 = RGBA).
+ */
+typedef struct image{
+    uint32 width;
+    uint32 height;
+    uint32 stride;
+    uint32 channels;
+} image_t;
+
+// 4:4:4 YCbCr frame size in bytes
+#define YCBCR_FRAME_SIZE(image) ((size_t)(image)->stride * (image)->height * 3)
+// One row of Y0Y1Y2Y3CbCr macro-pixels covers two rows of the source frame
+#define DOWNSAMPLED_ROW_SIZE(image) ((size_t)(((image)->stride + 1) / 2) * 6)
+#define DOWNSAMPLED_FRAME_SIZE(image) (DOWNSAMPLED_ROW_SIZE(image) * (((image)->height + 1) / 2))
+
+/**
+ * Chroma subsampling of the frames written out. Every mode but 4:4:4 stores rows of sampling blocks the
+ * way TIFF does: the horizontal x vertical Y samples of the block, then one Cb and one Cr. The box
+ * modes average the chroma of the block, which centres it between the Y samples; the co-sited 4:2:0 one
+ * runs a [1 2 1] tap across and down around the top-left Y sample instead. 4:4:4 is the YCbCr frame as it is.
+ */
+typedef enum { SUBSAMPLING_420, SUBSAMPLING_422, SUBSAMPLING_411, SUBSAMPLING_444, SUBSAMPLING_420_COSITED } subsampling_t;
+#define SUBSAMPLING_MODES 5
+
+typedef struct subsampling_mode{
+    const char* name;
+    int horizontal;
+    int vertical;
+    uint16 positioning;     // YCBCRPOSITION_CENTERED or YCBCRPOSITION_COSITED
+} subsampling_mode_t;
+
+extern const subsampling_mode_t subsampling_modes[SUBSAMPLING_MODES];
+
+// "420", "422", "411", "444" or "420-cosited"; false for anything else
+bool parse_subsampling(const char* name, subsampling_t* subsampling);
+
+// Rows of horizontal x vertical sampling blocks, DOWNSAMPLED_ROW_SIZE is the 2 x 2 one
+#define SUBSAMPLED_ROW_SIZE(image, horizontal, vertical) \
+    ((size_t)(((image)->stride + (horizontal) - 1) / (horizontal)) * ((horizontal) * (vertical) + 2))
+#define SUBSAMPLED_FRAME_SIZE(image, horizontal, vertical) \
+    (SUBSAMPLED_ROW_SIZE(image, horizontal, vertical) * (((image)->height + (vertical) - 1) / (vertical)))
+
+static inline size_t subsampled_frame_size(const image_t* image, subsampling_t subsampling){
+    return SUBSAMPLED_FRAME_SIZE(image, subsampling_modes[subsampling].horizontal, subsampling_modes[subsampling].vertical);
+}
+
+// 4:4:4 is converted as it is written and box 4:2:0 has a fused kernel, the other modes subsample a 4:4:4 frame
+static inline bool subsampling_via_ycbcr(subsampling_t subsampling, bool two_stage){
+    return subsampling != SUBSAMPLING_444 && (subsampling != SUBSAMPLING_420 || two_stage);
+}
+
+/**
+ * Planar 4:2:0 frames for video encoders: a full resolution Y plane of stride bytes per row, then either
+ * separate Cb and Cr planes (I420) or one plane of interleaved CbCr pairs (NV12), both at half resolution.
+ * The planes follow each other in one buffer of PLANAR_FRAME_SIZE bytes.
+ */
+typedef enum { LAYOUT_I420, LAYOUT_NV12 } planar_layout_t;
+
+typedef struct planes{
+    uint8* y;
+    uint8* cb;          // Cb plane, the interleaved CbCr plane for NV12
+    uint8* cr;          // NULL for NV12
+} planes_t;
+
+// Bytes per row of one chroma plane, an NV12 CbCr row is twice as long
+#define CHROMA_STRIDE(image) (((image)->stride + 1) / 2)
+#define Y_PLANE_SIZE(image) ((size_t)(image)->stride * (image)->height)
+#define CHROMA_PLANE_SIZE(image) ((size_t)CHROMA_STRIDE(image) * (((image)->height + 1) / 2))
+#define PLANAR_FRAME_SIZE(image) (Y_PLANE_SIZE(image) + 2 * CHROMA_PLANE_SIZE(image))
+
+/**
+ * Packed RGB frames as cameras, capture cards and ffmpeg's rawvideo hand them over, read as they are by
+ * the packed kernels instead of going through the ABGR raster first. RGBA is the byte order of the
+ * libtiff raster, BGRA that of most capture cards. The 16-bit samples of RGB48 are little endian and
+ * rounded to 8 bits like convert48. Rows are image->stride pixels of pixel_formats[format].bytes apart.
+ */
+typedef enum { PIXEL_RGBA, PIXEL_BGRA, PIXEL_RGB24, PIXEL_RGB48 } pixel_format_t;
+#define PIXEL_FORMATS 4
+
+typedef struct pixel_format_info{
+    const char* name;       // as ffmpeg's -pix_fmt calls it
+    uint32 bytes;           // per pixel
+} pixel_format_info_t;
+
+extern const pixel_format_info_t pixel_formats[PIXEL_FORMATS];
+
+// "rgba", "bgra", "rgb24" or "rgb48le"; false for anything else
+bool parse_pixel_format(const char* name, pixel_format_t* format);
+
+// Calls kernel(pixels, format, ...) with the format as a constant, so every format gets its own copy of an inlined kernel
+#define SPECIALIZE_PIXEL_FORMAT(kernel, pixels, format, ...) \
+    switch (format) { \
+        case PIXEL_RGBA: kernel(pixels, PIXEL_RGBA, __VA_ARGS__); break; \
+        case PIXEL_BGRA: kernel(pixels, PIXEL_BGRA, __VA_ARGS__); break; \
+        case PIXEL_RGB24: kernel(pixels, PIXEL_RGB24, __VA_ARGS__); break; \
+        case PIXEL_RGB48: kernel(pixels, PIXEL_RGB48, __VA_ARGS__); break; \
+    }
+// Kernels behind SPECIALIZE_PIXEL_FORMAT, GCC would rather call one copy of row loops this long with the format as an argument
+#define FORMAT_KERNEL static inline __attribute__((always_inline))
+
+// Chroma upsampling of the inverse 4:2:0 -> RGB conversion
+typedef enum { UPSAMPLE_NEAREST, UPSAMPLE_BILINEAR } upsample_t;
+
+// Absolute errors of 0, 1, 2, 3, 4-7, 8-15, 16-31 and 32 or more
+#define ERROR_BINS 8
+
+// Running error of one plane against its reference, see compare_frames()
+typedef struct sample_error{
+    uint64 samples;
+    uint64 sum_squares;
+    uint64 histogram[ERROR_BINS];
+    uint8 max_error;
+} sample_error_t;
+
+/**
+ * Colour matrix and quantization range of the YCbCr samples. Studio range puts Y in 16..235 and Cb/Cr
+ * in 16..240, full range uses all of 0..255 for every sample.
+ */
+typedef enum { MATRIX_BT601, MATRIX_BT709, MATRIX_BT2020 } color_matrix_t;
+typedef enum { RANGE_STUDIO, RANGE_FULL } color_range_t;
+
+typedef struct color_space{
+    color_matrix_t matrix;
+    color_range_t range;
+} color_space_t;
+
+#define COLOR_SPACES 6
+#define COLOR_SPACE_INDEX(space) ((space)->matrix * 2 + (space)->range)
+
+/**
+ * Every kernel depending on the matrix is generated once per color space (see color_spaces.inc), the
+ * list below names them in COLOR_SPACE_INDEX order for the declarations and the kernel tables.
+ */
+#define FOR_EACH_COLOR_SPACE(X, ...) \
+    X(bt601, __VA_ARGS__) X(bt601_full, __VA_ARGS__) X(bt709, __VA_ARGS__) \
+    X(bt709_full, __VA_ARGS__) X(bt2020, __VA_ARGS__) X(bt2020_full, __VA_ARGS__)
+
+/**
+ * 8-bit fixed-point coefficients of one color space, scaled by 256 for the forward conversion:
+ *   Y  = ((y_r R + y_g G + y_b B) >> 8) + y_offset
+ *   Cb = (uint16) (32768 - cb_r R - cb_g G + cb_b B) >> 8
+ *   Cr = (uint16) (32768 + cr_r R - cr_g G - cr_b B) >> 8
+ * The inverse ones are Q13, see ycbcr_to_rgb_fixed(), the precise ones those of convert48_pixel_precise().
+ * The SIMD kernels use the same values as constants.
+ */
+typedef struct fixed_coefficients{
+    int32 y_r, y_g, y_b, y_offset;
+    int32 cb_r, cb_g, cb_b;
+    int32 cr_r, cr_g, cr_b;
+    int16 inverse_y, inverse_cr_r, inverse_cb_g, inverse_cr_g, inverse_cb_b;
+    int32 precise_y_r, precise_y_g, precise_y_b;
+    int32 precise_cb_r, precise_cb_g, precise_cb_b;
+    int32 precise_cr_r, precise_cr_g, precise_cr_b;
+} fixed_coefficients_t;
+
+/**
+ * One set of row kernels per instruction set and color space. Each one processes `rows` rows starting
+ * at the rows the source and destination pointers point to; the downsampling kernels expect the band
+ * to start on an even row and repeat the last row when `rows` is odd.
+ */
+typedef struct kernels{
+    const char* name;
+    void (*convert)(const uint32* raster, uint8* ycbcr, const image_t* image, uint32 rows);
+    void (*convert48)(const uint16* rgb, uint8* ycbcr, const image_t* image, uint32 rows);
+    // 16-bit samples through 32-bit sums and rounding, see convert48_pixel_precise()
+    void (*convert48_precise)(const uint16* rgb, uint8* ycbcr, const image_t* image, uint32 rows);
+    void (*downsample)(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 rows);
+    void (*convert420)(const uint32* raster, uint8* downsampled_ycbcr, const image_t* image, uint32 rows);
+    void (*downsample_planar)(const uint8* ycbcr, const planes_t* planes, const image_t* image, uint32 rows);
+    // 4:2:2 and 4:1:1 blocks of single rows
+    void (*downsample422)(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows);
+    void (*downsample411)(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows);
+    // co-sited 4:2:0, the pointers are to the whole frames since the filter reads the row above the band
+    void (*downsample420_cosited)(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 first_row, uint32 rows);
+    void (*convert420_planar)(const uint32* raster, const planes_t* planes, const image_t* image, uint32 rows);
+    // convert and convert420_planar of any packed format, the loads are specialized per format
+    void (*convert_packed)(const uint8* pixels, pixel_format_t format, uint8* ycbcr, const image_t* image, uint32 rows);
+    void (*convert420_planar_packed)(const uint8* pixels, pixel_format_t format, const planes_t* planes, const image_t* image, uint32 rows);
+    // 2x2 box filter of RGBA rows into rows of (width + 1) / 2 pixels half_stride apart, odd edges repeat the last column and row
+    void (*halve)(const uint32* raster, uint32* half, const image_t* image, uint32 half_stride, uint32 rows);
+    // inverse conversion, the pointers are to the whole frames since bilinear filtering reads around the band
+    void (*convert420_to_rgb)(const uint8* downsampled_ycbcr, uint32* raster, const image_t* image, uint32 first_row, uint32 rows, upsample_t filter);
+    // adds n sample pairs to the error, not a conversion but as hot on large frames
+    void (*compare)(const uint8* reference, const uint8* samples, uint32 n, sample_error_t* error);
+} kernel_table_t;
+
+// Kernels picked by select_kernels(), the portable scalar ones until then
+extern const kernel_table_t* kernels;
+// Scalar tables in COLOR_SPACE_INDEX order, whatever select_kernels() picked
+extern const kernel_table_t scalar_kernels[COLOR_SPACES];
+void select_kernels(void);
+
+// Most instruction sets supported_kernels() returns, NEON and scalar or AVX-512 down to scalar on x86
+#define ISA_KERNELS 4
+// Tables of every instruction set the CPU runs, the widest first and the scalar ones last; returns how many
+uint32 supported_kernels(const kernel_table_t** tables);
+// Switches to the instruction set of one of those, the color space stays
+void select_isa_kernels(const kernel_table_t* tables);
+
+// Color space of the kernels, BT.601 studio range unless select_color_space() picked another one
+extern color_space_t color_space;
+void select_color_space(const color_space_t* space);
+
+/**
+ * Large-frame mode, for 4K and 8K frames far past the last level cache. frame_alloc() puts frames of a
+ * huge page or more on transparent huge pages, so a frame takes a few dozen TLB entries instead of
+ * thousands. The x86 conversion and downsampling rows prefetch their input PREFETCH_DISTANCE bytes
+ * ahead, across the 4 KB boundaries the hardware prefetchers stop at, and write their outputs with
+ * non-temporal stores: each output line is written once and read at most once much later, so caching
+ * it only evicts input and costs a read for ownership. Off by default, smaller frames are better
+ * served by the caches.
+ */
+extern bool large_frames;
+#define HUGE_PAGE_SZ ((size_t) 2 << 20)
+// Bytes of input ahead of the block being converted, a few hundred ns of one core streaming
+#define PREFETCH_DISTANCE 1024
+
+// "bt601", "bt709" or "bt2020", with "-full" for full range; false for anything else
+bool parse_color_space(const char* name, color_space_t* space);
+const char* color_space_name(const color_space_t* space);
+
+// Kr and Kb of the matrix, Y = Kr R + (1 - Kr - Kb) G + Kb B, for the floating-point references
+void matrix_weights(color_matrix_t matrix, double* kr, double* kb);
+
+
+// Scalar equivalent of the 8-bit fixed-point arithmetic of every SIMD backend
+static inline void convert_pixel_fixed(const fixed_coefficients_t* c, uint8 r, uint8 g, uint8 b, uint8* ycbcr){
+    ycbcr[0] = (uint8) (((c->y_r * r + c->y_g * g + c->y_b * b) >> 8) + c->y_offset);
+    ycbcr[1] = (uint8) ((uint16) (32768 - c->cb_r * r - c->cb_g * g + c->cb_b * b) >> 8);
+    ycbcr[2] = (uint8) ((uint16) (32768 + c->cr_r * r - c->cr_g * g - c->cr_b * b) >> 8);
+}
+
+// NEON vrhaddq_u8 and SSE pavgb round every halving add, the scalar code has to round the same way
+static inline uint8 rhadd(uint8 a, uint8 b){
+    return (uint8) ((a + b + 1) >> 1);
+}
+
+// Rounded, saturated high byte of a 16-bit sample, same as vqrshrn_n_u16(sample, 8)
+static inline uint8 narrow_sample(uint16 sample){
+    return (uint8) (sample >= 65408 ? 255 : (sample + 128) >> 8);
+}
+
+/**
+ * Full precision conversion of one pixel of 16-bit samples. The weights are Q22 and include the 1/257
+ * of the 16 -> 8 bit scale, the sums are 32-bit and rounded to nearest. The samples are biased by
+ * -32768 to fit the signed 16-bit multiplies of pmaddwd and vmlal_s16, PRECISE_BIAS adds back 32768
+ * times the sum of the signed weights along with the offset and the rounding half.
+ */
+#define PRECISE_SHIFT 22
+#define PRECISE_BIAS(w_r, w_g, w_b, offset) (32768 * ((w_r) + (w_g) + (w_b)) + ((offset) << PRECISE_SHIFT) + (1 << (PRECISE_SHIFT - 1)))
+
+static inline uint8 precise_sample(int32 sum){
+    return (uint8) (sum < 0 ? 0 : (sum >> PRECISE_SHIFT) > 255 ? 255 : sum >> PRECISE_SHIFT);
+}
+
+static inline void convert48_pixel_precise(const fixed_coefficients_t* c, uint16 r, uint16 g, uint16 b, uint8* ycbcr){
+    int32 r_biased = r - 32768, g_biased = g - 32768, b_biased = b - 32768;
+
+    ycbcr[0] = precise_sample(c->precise_y_r * r_biased + c->precise_y_g * g_biased + c->precise_y_b * b_biased +
+                              PRECISE_BIAS(c->precise_y_r, c->precise_y_g, c->precise_y_b, c->y_offset));
+    ycbcr[1] = precise_sample(-c->precise_cb_r * r_biased - c->precise_cb_g * g_biased + c->precise_cb_b * b_biased +
+                              PRECISE_BIAS(-c->precise_cb_r, -c->precise_cb_g, c->precise_cb_b, 128));
+    ycbcr[2] = precise_sample(c->precise_cr_r * r_biased - c->precise_cr_g * g_biased - c->precise_cr_b * b_biased +
+                              PRECISE_BIAS(c->precise_cr_r, -c->precise_cr_g, -c->precise_cr_b, 128));
+}
+
+// One pixel of an RGBA raster halved in both directions, averaged like the chroma of downsample_pixel_fixed()
+static inline void halve_pixel_fixed(const uint8* pixel_i, const uint8* pixel_j, uint32 next, uint8* half_pixel){
+    for (int k = 0; k < 4; ++k) {
+        half_pixel[k] = rhadd(rhadd(pixel_i[k], pixel_i[next+k]), rhadd(pixel_j[k], pixel_j[next+k]));
+    }
+}
+
+// One Y0Y1Y2Y3CbCr macro-pixel from two 4:4:4 rows, `next` is the byte offset of the right neighbour
+static inline void downsample_pixel_fixed(const uint8* pixel_i, const uint8* pixel_j, uint32 next, uint8* downsampled_pixel){
+    downsampled_pixel[0] = pixel_i[0];
+    downsampled_pixel[1] = pixel_i[next];
+    downsampled_pixel[2] = pixel_j[0];
+    downsampled_pixel[3] = pixel_j[next];
+    downsampled_pixel[4] = rhadd(rhadd(pixel_i[1], pixel_i[next+1]), rhadd(pixel_j[1], pixel_j[next+1]));
+    downsampled_pixel[5] = rhadd(rhadd(pixel_i[2], pixel_i[next+2]), rhadd(pixel_j[2], pixel_j[next+2]));
+}
+
+// One Y0Y1CbCr block of a 4:2:2 row, `next` is the byte offset of the right neighbour
+static inline void downsample422_pixel_fixed(const uint8* pixel, uint32 next, uint8* block){
+    block[0] = pixel[0];
+    block[1] = pixel[next];
+    block[2] = rhadd(pixel[1], pixel[next+1]);
+    block[3] = rhadd(pixel[2], pixel[next+2]);
+}
+
+// The Y0Y1Y2Y3CbCr block at col of a 4:1:1 row, the columns past the width repeat the last one
+static inline void downsample411_pixel_fixed(const uint8* row_ptr, uint32 col, uint32 width, uint8* block){
+    const uint8* pixels[4];
+
+    for (uint32 k = 0; k < 4; ++k) {
+        pixels[k] = row_ptr + (col + k < width ? col + k : width - 1) * 3;
+        block[k] = pixels[k][0];
+    }
+    block[4] = rhadd(rhadd(pixels[0][1], pixels[1][1]), rhadd(pixels[2][1], pixels[3][1]));
+    block[5] = rhadd(rhadd(pixels[0][2], pixels[1][2]), rhadd(pixels[2][2], pixels[3][2]));
+}
+
+// [1 2 1] sum of one chroma sample around col of a 4:4:4 row, the edge columns repeat
+static inline uint32 chroma_tap(const uint8* row_ptr, uint32 col, uint32 width, int sample){
+    uint32 left = col > 0 ? col - 1 : 0;
+    uint32 right = col + 1 < width ? col + 1 : col;
+    return row_ptr[left * 3 + sample] + 2 * row_ptr[col * 3 + sample] + row_ptr[right * 3 + sample];
+}
+
+/**
+ * The macro-pixel at the even col of a co-sited 4:2:0 row: the Y of row_i and row_j, and the chroma of
+ * the top-left pixel filtered [1 2 1] across and [1 2 1] down over above, row_i and row_j. The caller
+ * repeats row_i for the missing rows at the top and bottom of the frame.
+ */
+static inline void downsample420_cosited_pixel_fixed(const uint8* above, const uint8* row_i_ptr, const uint8* row_j_ptr, uint32 col, uint32 width,
+                                                     uint8* downsampled_pixel){
+    uint32 next = (col + 1 < width) ? 3 : 0;
+
+    downsampled_pixel[0] = row_i_ptr[col * 3];
+    downsampled_pixel[1] = row_i_ptr[col * 3 + next];
+    downsampled_pixel[2] = row_j_ptr[col * 3];
+    downsampled_pixel[3] = row_j_ptr[col * 3 + next];
+    for (int sample = 1; sample < 3; ++sample) {
+        uint32 sum = chroma_tap(above, col, width, sample) + 2 * chroma_tap(row_i_ptr, col, width, sample) + chroma_tap(row_j_ptr, col, width, sample);
+        downsampled_pixel[3 + sample] = (uint8) ((sum + 8) >> 4);
+    }
+}
+
+// Converts the 2x2 block at col of two raster rows into one macro-pixel
+static inline void convert420_pixel_fixed(const fixed_coefficients_t* c, const uint32* row_i_ptr, const uint32* row_j_ptr, uint32 col, uint32 width,
+                                          uint8* downsampled_pixel){
+    uint8 pixels[2][6];
+    uint32 next = (col + 1 < width) ? col + 1 : col;
+
+    convert_pixel_fixed(c, TIFFGetR(row_i_ptr[col]), TIFFGetG(row_i_ptr[col]), TIFFGetB(row_i_ptr[col]), pixels[0]);
+    convert_pixel_fixed(c, TIFFGetR(row_i_ptr[next]), TIFFGetG(row_i_ptr[next]), TIFFGetB(row_i_ptr[next]), pixels[0] + 3);
+    convert_pixel_fixed(c, TIFFGetR(row_j_ptr[col]), TIFFGetG(row_j_ptr[col]), TIFFGetB(row_j_ptr[col]), pixels[1]);
+    convert_pixel_fixed(c, TIFFGetR(row_j_ptr[next]), TIFFGetG(row_j_ptr[next]), TIFFGetB(row_j_ptr[next]), pixels[1] + 3);
+    downsample_pixel_fixed(pixels[0], pixels[1], 3, downsampled_pixel);
+}
+
+// 8-bit R, G and B of pixel col of a packed row, the kernels call it with a constant format
+static inline void packed_pixel_rgb(const uint8* row, pixel_format_t format, uint32 col, uint8* rgb){
+    const uint8* pixel;
+
+    switch (format) {
+        case PIXEL_RGBA:
+        case PIXEL_RGB24:
+            pixel = row + (size_t) col * (format == PIXEL_RGBA ? 4 : 3);
+            rgb[0] = pixel[0];
+            rgb[1] = pixel[1];
+            rgb[2] = pixel[2];
+            break;
+        case PIXEL_BGRA:
+            pixel = row + (size_t) col * 4;
+            rgb[0] = pixel[2];
+            rgb[1] = pixel[1];
+            rgb[2] = pixel[0];
+            break;
+        case PIXEL_RGB48:
+            pixel = row + (size_t) col * 6;
+            rgb[0] = narrow_sample((uint16) (pixel[0] | pixel[1] << 8));
+            rgb[1] = narrow_sample((uint16) (pixel[2] | pixel[3] << 8));
+            rgb[2] = narrow_sample((uint16) (pixel[4] | pixel[5] << 8));
+            break;
+    }
+}
+
+// convert420_pixel_fixed of two packed rows
+static inline void convert420_packed_pixel_fixed(const fixed_coefficients_t* c, const uint8* row_i_ptr, const uint8* row_j_ptr, pixel_format_t format,
+                                                 uint32 col, uint32 width, uint8* downsampled_pixel){
+    uint8 pixels[2][6], rgb[3];
+    uint32 next = (col + 1 < width) ? col + 1 : col;
+
+    packed_pixel_rgb(row_i_ptr, format, col, rgb);
+    convert_pixel_fixed(c, rgb[0], rgb[1], rgb[2], pixels[0]);
+    packed_pixel_rgb(row_i_ptr, format, next, rgb);
+    convert_pixel_fixed(c, rgb[0], rgb[1], rgb[2], pixels[0] + 3);
+    packed_pixel_rgb(row_j_ptr, format, col, rgb);
+    convert_pixel_fixed(c, rgb[0], rgb[1], rgb[2], pixels[1]);
+    packed_pixel_rgb(row_j_ptr, format, next, rgb);
+    convert_pixel_fixed(c, rgb[0], rgb[1], rgb[2], pixels[1] + 3);
+    downsample_pixel_fixed(pixels[0], pixels[1], 3, downsampled_pixel);
+}
+
+
+// Rounding Q15 multiply-high, the same as _mm_mulhrs_epi16 and vqrdmulhq_s16
+static inline int16 mulhrs(int16 a, int16 b){
+    return (int16) (((int32) a * b + 16384) >> 15);
+}
+
+static inline uint8 clamp_sample(int32 sample){
+    return (uint8) (sample < 0 ? 0 : sample > 255 ? 255 : sample);
+}
+
+/**
+ * Inverse of convert_pixel_fixed. The samples are scaled by 64 and the coefficients are Q13, so each
+ * product is one rounding multiply-high in a 16-bit lane and the sum keeps 4 fractional bits.
+ */
+static inline void ycbcr_to_rgb_fixed(const fixed_coefficients_t* c, uint8 y, uint8 cb, uint8 cr, uint8* rgba){
+    int16 luma = mulhrs((int16) ((y - c->y_offset) * 64), c->inverse_y);
+    int16 d = (int16) ((cb - 128) * 64);
+    int16 e = (int16) ((cr - 128) * 64);
+
+    rgba[0] = clamp_sample((luma + mulhrs(e, c->inverse_cr_r) + 8) >> 4);
+    rgba[1] = clamp_sample((luma - mulhrs(d, c->inverse_cb_g) - mulhrs(e, c->inverse_cr_g) + 8) >> 4);
+    rgba[2] = clamp_sample((luma + mulhrs(d, c->inverse_cb_b) + 8) >> 4);
+    rgba[3] = 255;
+}
+
+// Bilinear 3:1 weights of the centered chroma samples around a pixel, first down the rows, then across
+static inline uint8 upsample_chroma(uint8 near, uint8 far_row, uint8 far_col, uint8 far_both){
+    uint32 near_col = 3 * near + far_row;
+    uint32 other_col = 3 * far_col + far_both;
+    return (uint8) ((3 * near_col + other_col + 8) >> 4);
+}
+
+/**
+ * The up to 2x2 RGBA pixels of the macro-pixel at the even row/col of the frame. The bottom row is left
+ * out when it is not part of the band, bilinear filtering repeats the edge macro-pixels.
+ */
+static inline void rgb420_pixel_fixed(const fixed_coefficients_t* c, const uint8* downsampled_ycbcr, uint32* raster, const image_t* image,
+                                      uint32 row, uint32 col, bool bottom, upsample_t filter){
+    size_t row_size = DOWNSAMPLED_ROW_SIZE(image);
+    const uint8* pixel = downsampled_ycbcr + (row / 2) * row_size + (col / 2) * 6;
+    // nearest other macro-pixel row above/below and column left/right
+    const uint8* other_row[2] = {row > 0 ? pixel - row_size : pixel, row + 2 < image->height ? pixel + row_size : pixel};
+    int32 other_col[2] = {col > 0 ? -6 : 0, col + 2 < image->width ? 6 : 0};
+
+    for (uint32 dy = 0; dy < (bottom ? 2u : 1u); ++dy) {
+        for (uint32 dx = 0; dx < 2 && col + dx < image->width; ++dx) {
+            uint8 cb = pixel[4], cr = pixel[5];
+            if (filter == UPSAMPLE_BILINEAR) {
+                cb = upsample_chroma(pixel[4], other_row[dy][4], pixel[other_col[dx] + 4], other_row[dy][other_col[dx] + 4]);
+                cr = upsample_chroma(pixel[5], other_row[dy][5], pixel[other_col[dx] + 5], other_row[dy][other_col[dx] + 5]);
+            }
+            ycbcr_to_rgb_fixed(c, pixel[dy * 2 + dx], cb, cr, (uint8*) (raster + (size_t) (row + dy) * image->stride + col + dx));
+        }
+    }
+}
+
+
+// Histogram bin of an absolute error, the bins double in width from 4 on
+static inline int error_bin(uint8 error){
+    return error < 4 ? error : error < 8 ? 4 : error < 16 ? 5 : error < 32 ? 6 : 7;
+}
+
+static inline void add_sample_error(uint8 reference, uint8 sample, sample_error_t* error){
+    uint8 difference = reference > sample ? reference - sample : sample - reference;
+    error->samples++;
+    error->sum_squares += (uint32) difference * difference;
+    error->histogram[error_bin(difference)]++;
+    error->max_error = difference > error->max_error ? difference : error->max_error;
+}
+
+
+// Plane pointers of a PLANAR_FRAME_SIZE frame
+static inline planes_t frame_planes(uint8* frame, const image_t* image, planar_layout_t layout){
+    planes_t planes = {frame, frame + Y_PLANE_SIZE(image), NULL};
+    if (layout == LAYOUT_I420) {
+        planes.cr = planes.cb + CHROMA_PLANE_SIZE(image);
+    }
+    return planes;
+}
+
+// Planes moved down to the (even) row `row` of the frame
+static inline planes_t planes_at_row(const planes_t* planes, const image_t* image, uint32 row){
+    size_t chroma_offset = (size_t) (row / 2) * CHROMA_STRIDE(image);
+    planes_t moved = {planes->y + (size_t) row * image->stride, planes->cb, planes->cr};
+
+    if (planes->cr != NULL) {
+        moved.cb += chroma_offset;
+        moved.cr += chroma_offset;
+    } else {
+        moved.cb += chroma_offset * 2;
+    }
+    return moved;
+}
+
+/**
+ * Scatters the macro-pixel of column col into the planes of a row pair, y_next is the distance to the
+ * second Y row (0 on the repeated last row of odd heights). The last column of odd widths has no Y01/Y11.
+ */
+static inline void store_planar_pixel(const uint8* downsampled_pixel, const planes_t* row_planes, uint32 y_next, uint32 col, uint32 width){
+    row_planes->y[col] = downsampled_pixel[0];
+    row_planes->y[y_next + col] = downsampled_pixel[2];
+    if (col + 1 < width) {
+        row_planes->y[col + 1] = downsampled_pixel[1];
+        row_planes->y[y_next + col + 1] = downsampled_pixel[3];
+    }
+    if (row_planes->cr != NULL) {
+        row_planes->cb[col / 2] = downsampled_pixel[4];
+        row_planes->cr[col / 2] = downsampled_pixel[5];
+    } else {
+        row_planes->cb[col] = downsampled_pixel[4];
+        row_planes->cb[col + 1] = downsampled_pixel[5];
+    }
+}
+
+
+// TIFF I/O
+uint32 * read_tiff_image(char* filename, image_t* image);
+bool read_tiff_raster(const char* filename, image_t* image, uint32** raster, size_t* capacity);
+bool read_tiff_size(const char* filename, image_t* image);
+uint16* read_tiff_image_rgb48(char* filename, image_t* image);
+
+/**
+ * Uncompressed files laid out like the frame are mapped instead of read, the kernels run straight from
+ * the page cache; NULL means the file has to go through read_tiff_raster / read_tiff_image_rgb48.
+ */
+typedef struct mapped_file{
+    void* base;
+    size_t length;
+} mapped_file_t;
+
+const uint32* map_tiff_raster(const char* filename, image_t* image, mapped_file_t* mapping);
+const uint16* map_tiff_rgb48(const char* filename, image_t* image, mapped_file_t* mapping);
+void unmap_tiff(mapped_file_t* mapping);
+void write_tiff_image(uint8 *image, char* filename, const image_t* frame, subsampling_t subsampling);
+TIFF* open_tiff_output(char* filename, const image_t* frame, subsampling_t subsampling, uint32 rows_per_strip);
+void write_tiff_strips(TIFF* tiff_output, const uint8* image, const image_t* frame, uint32 first_row, uint32 rows, subsampling_t subsampling);
+void set_tiff_compression(uint16 compression);
+
+// RGBA TIFF of a raster, for previews of the inverse conversion
+void write_tiff_rgb_image(const uint32* raster, char* filename, const image_t* image);
+
+// Raw .yuv output, the planes packed to the image width one after the other
+void write_yuv_image(const uint8* frame, char* filename, const image_t* image, planar_layout_t layout);
+
+// Strip-by-strip 4:2:0 conversion with pipelined read, convert, downsample and write threads
+size_t convert_tiff_streaming(char* input_filename, char* output_filename, uint32 ring_size);
+/**
+ * Raw video pipe mode: packed frames of the image size and pixel format, ffmpeg's rawvideo, are read from
+ * input_fd until it ends and written to output_fd as I420 or NV12 planes with no padding. Reading,
+ * conversion and writing overlap on two frame buffers. Returns the number of frames converted.
+ */
+uint64 convert_raw_pipe(int input_fd, int output_fd, const image_t* image, pixel_format_t format, planar_layout_t layout);
+
+// Frame kernels, each returns a newly allocated cache-line aligned frame the caller frees
+uint8* downsample_ycbcr(const uint8* ycbcr, const image_t* image);
+uint8* downsample_ycbcr_v1(const uint8* ycbcr, const image_t* image);
+uint8* downsample_ycbcr_v2(const uint8* ycbcr, const image_t* image);
+uint8* downsample_ycbcr_simd(const uint8* ycbcr, const image_t* image);
+uint8* downsample_ycbcr_v4(const uint8* ycbcr, const image_t* image);
+uint8* convert_rgb_to_ycbcr(const uint32 *raster, const image_t* image);
+uint8* convert_rgb_to_ycbcr_v1(const uint32 *raster, const image_t* image);
+uint8* convert_rgb_to_ycbcr_v2(const uint32 *raster, const image_t* image);
+uint8* convert_rgb_to_ycbcr_v2_5(const uint32 *raster, const image_t* image);
+uint8* convert_rgb_to_ycbcr_v3(const uint32 *raster, const image_t* image);
+uint8* convert_rgb_to_ycbcr_v4(const uint32 *raster, const image_t* image);
+uint8* convert_rgb_to_ycbcr_lut(const uint32 *raster, const image_t* image);
+uint8* convert_rgb48_to_ycbcr_v1(const uint16 *rgb, const image_t* image);
+uint8* convert_rgb48_to_ycbcr_simd(const uint16 *rgb, const image_t* image);
+uint8* convert_rgb48_to_ycbcr_lut(const uint16 *rgb, const image_t* image);
+uint8* convert_rgb48_to_ycbcr_precise(const uint16 *rgb, const image_t* image);
+uint8* convert_rgb_to_ycbcr420_simd(const uint32 *raster, const image_t* image);
+uint8* convert_rgb_to_ycbcr420_two_stage(const uint32 *raster, const image_t* image);
+uint8* convert_rgb_to_ycbcr420_v4(const uint32 *raster, const image_t* image);
+
+// Same kernels writing into a caller-owned frame of YCBCR_FRAME_SIZE / DOWNSAMPLED_FRAME_SIZE bytes, subsampled_frame_size() for 4:2:2 and 4:1:1
+void downsample_ycbcr_into(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image);
+void downsample_ycbcr_v1_into(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image);
+void downsample_ycbcr_v2_into(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image);
+void downsample_ycbcr_simd_into(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image);
+void downsample_ycbcr_v4_into(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image);
+void downsample_ycbcr_422_simd_into(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image);
+void downsample_ycbcr_411_simd_into(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image);
+void downsample_ycbcr_cosited_simd_into(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image);
+void downsample_ycbcr_444_into(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image);
+void convert_rgb_to_ycbcr_into(const uint32* raster, uint8* ycbcr, const image_t* image);
+void convert_rgb_to_ycbcr_v1_into(const uint32* raster, uint8* ycbcr, const image_t* image);
+void convert_rgb_to_ycbcr_v2_into(const uint32* raster, uint8* ycbcr, const image_t* image);
+void convert_rgb_to_ycbcr_v2_5_into(const uint32* raster, uint8* ycbcr, const image_t* image);
+void convert_rgb_to_ycbcr_v3_into(const uint32* raster, uint8* ycbcr, const image_t* image);
+void convert_rgb_to_ycbcr_lut_into(const uint32* raster, uint8* ycbcr, const image_t* image);
+void convert_rgb_to_ycbcr_v4_into(const uint32* raster, uint8* ycbcr, const image_t* image);
+void convert_rgb48_to_ycbcr_into(const uint16* rgb, uint8* ycbcr, const image_t* image);
+void convert_rgb48_to_ycbcr_v1_into(const uint16* rgb, uint8* ycbcr, const image_t* image);
+void convert_rgb48_to_ycbcr_simd_into(const uint16* rgb, uint8* ycbcr, const image_t* image);
+void convert_rgb48_to_ycbcr_lut_into(const uint16* rgb, uint8* ycbcr, const image_t* image);
+void convert_rgb48_to_ycbcr_precise_into(const uint16* rgb, uint8* ycbcr, const image_t* image);
+void convert_rgb_to_ycbcr420_simd_into(const uint32* raster, uint8* downsampled_ycbcr, const image_t* image);
+void convert_rgb_to_ycbcr420_two_stage_into(const uint32* raster, uint8* downsampled_ycbcr, const image_t* image);
+void convert_rgb_to_ycbcr420_v4_into(const uint32* raster, uint8* downsampled_ycbcr, const image_t* image);
+
+// Any subsampling mode into a frame of subsampled_frame_size() bytes, the plain reference and through the kernel table
+void subsample_ycbcr_into(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, subsampling_t subsampling);
+void subsample_ycbcr_simd_into(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, subsampling_t subsampling);
+/**
+ * RGB straight to any subsampling mode on the calling thread, the fused kernel for 4:2:0 unless two_stage.
+ * ycbcr is a 4:4:4 frame of YCBCR_FRAME_SIZE bytes for the modes that go through one, see subsampling_via_ycbcr().
+ */
+void convert_rgb_to_subsampled_into(const uint32* raster, uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, subsampling_t subsampling,
+                                    bool two_stage);
+
+// Planar kernels writing a caller-owned frame of PLANAR_FRAME_SIZE bytes in I420 or NV12 layout
+void downsample_ycbcr_i420_simd_into(const uint8* ycbcr, uint8* frame, const image_t* image);
+void downsample_ycbcr_nv12_simd_into(const uint8* ycbcr, uint8* frame, const image_t* image);
+void convert_rgb_to_i420_simd_into(const uint32* raster, uint8* frame, const image_t* image);
+void convert_rgb_to_nv12_simd_into(const uint32* raster, uint8* frame, const image_t* image);
+void convert_rgb_to_i420_v4_into(const uint32* raster, uint8* frame, const image_t* image);
+void convert_rgb_to_nv12_v4_into(const uint32* raster, uint8* frame, const image_t* image);
+
+// The same straight from packed pixels of any format, into a 4:4:4 frame or an I420 frame
+void convert_packed_to_ycbcr_simd_into(const uint8* pixels, pixel_format_t format, uint8* ycbcr, const image_t* image);
+void convert_packed_to_i420_simd_into(const uint8* pixels, pixel_format_t format, uint8* frame, const image_t* image);
+
+/**
+ * Proxies of a frame at 1/2, 1/4, ... 1/2^levels of its size, box filtered and converted in one read of
+ * the raster. Strips of 2^(levels + 1) rows are halved into the first level with the rounding halving
+ * adds of the downsampling kernels, that level into the next one and so on, and each level is
+ * converted while its rows are still cached, so only the small outputs go to memory. proxies[level - 1]
+ * is a 4:4:4 frame of YCBCR_FRAME_SIZE, or with i420 a PLANAR_FRAME_SIZE frame, of proxy_image().
+ * levels past MAX_PROXY_LEVELS convert MAX_PROXY_LEVELS proxies, 0 none.
+ */
+#define MAX_PROXY_LEVELS 4
+void convert_rgb_to_proxies_simd_into(const uint32* raster, uint8* const* proxies, uint32 levels, bool i420, const image_t* image);
+void convert_rgb_to_proxies_v4_into(const uint32* raster, uint8* const* proxies, uint32 levels, bool i420, const image_t* image);
+
+// Geometry of proxy level (1 = half size), odd sizes round up and the rows are packed
+static inline image_t proxy_image(const image_t* image, uint32 level){
+    image_t proxy = *image;
+    proxy.width = ((image->width - 1) >> level) + 1;
+    proxy.height = ((image->height - 1) >> level) + 1;
+    proxy.stride = proxy.width;
+    return proxy;
+}
+
+// Inverse 4:2:0 -> RGBA conversion into a caller-owned raster of stride * height pixels, the first one is the floating-point reference
+void convert_ycbcr420_to_rgb_into(const uint8* downsampled_ycbcr, uint32* raster, const image_t* image, upsample_t filter);
+void convert_ycbcr420_to_rgb_simd_into(const uint8* downsampled_ycbcr, uint32* raster, const image_t* image, upsample_t filter);
+void convert_ycbcr420_to_rgb_v4_into(const uint8* downsampled_ycbcr, uint32* raster, const image_t* image, upsample_t filter);
+
+/**
+ * Row kernels behind the kernel tables. The ones depending on the matrix are named after their color
+ * space too, convert_rows_bt709_full_avx2 say.
+ */
+#define DECLARE_COLOR_KERNELS(color, isa) \
+    void convert_rows_##color##_##isa(const uint32* raster, uint8* ycbcr, const image_t* image, uint32 rows); \
+    void convert48_rows_##color##_##isa(const uint16* rgb, uint8* ycbcr, const image_t* image, uint32 rows); \
+    void convert48_precise_rows_##color##_##isa(const uint16* rgb, uint8* ycbcr, const image_t* image, uint32 rows); \
+    void convert420_rows_##color##_##isa(const uint32* raster, uint8* downsampled_ycbcr, const image_t* image, uint32 rows); \
+    void convert420_planar_rows_##color##_##isa(const uint32* raster, const planes_t* planes, const image_t* image, uint32 rows); \
+    void convert_packed_rows_##color##_##isa(const uint8* pixels, pixel_format_t format, uint8* ycbcr, const image_t* image, uint32 rows); \
+    void convert420_planar_packed_rows_##color##_##isa(const uint8* pixels, pixel_format_t format, const planes_t* planes, const image_t* image, \
+                                                       uint32 rows); \
+    void convert420_to_rgb_rows_##color##_##isa(const uint8* downsampled_ycbcr, uint32* raster, const image_t* image, uint32 first_row, \
+                                                uint32 rows, upsample_t filter);
+
+FOR_EACH_COLOR_SPACE(DECLARE_COLOR_KERNELS, scalar)
+void downsample_rows_scalar(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample_planar_rows_scalar(const uint8* ycbcr, const planes_t* planes, const image_t* image, uint32 rows);
+void downsample422_rows_scalar(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample411_rows_scalar(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample420_cosited_rows_scalar(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 first_row, uint32 rows);
+void halve_rows_scalar(const uint32* raster, uint32* half, const image_t* image, uint32 half_stride, uint32 rows);
+void compare_samples_scalar(const uint8* reference, const uint8* samples, uint32 n, sample_error_t* error);
+#ifdef __ARM_NEON
+FOR_EACH_COLOR_SPACE(DECLARE_COLOR_KERNELS, neon)
+void downsample_rows_neon(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample_planar_rows_neon(const uint8* ycbcr, const planes_t* planes, const image_t* image, uint32 rows);
+void downsample422_rows_neon(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample411_rows_neon(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample420_cosited_rows_neon(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 first_row, uint32 rows);
+void halve_rows_neon(const uint32* raster, uint32* half, const image_t* image, uint32 half_stride, uint32 rows);
+void compare_samples_neon(const uint8* reference, const uint8* samples, uint32 n, sample_error_t* error);
+#endif
+#ifdef X86_KERNELS
+FOR_EACH_COLOR_SPACE(DECLARE_COLOR_KERNELS, sse41)
+void downsample_rows_sse41(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample_planar_rows_sse41(const uint8* ycbcr, const planes_t* planes, const image_t* image, uint32 rows);
+void downsample422_rows_sse41(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample411_rows_sse41(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample420_cosited_rows_sse41(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 first_row, uint32 rows);
+void halve_rows_sse41(const uint32* raster, uint32* half, const image_t* image, uint32 half_stride, uint32 rows);
+void compare_samples_sse41(const uint8* reference, const uint8* samples, uint32 n, sample_error_t* error);
+FOR_EACH_COLOR_SPACE(DECLARE_COLOR_KERNELS, avx2)
+void downsample_rows_avx2(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample_planar_rows_avx2(const uint8* ycbcr, const planes_t* planes, const image_t* image, uint32 rows);
+void downsample422_rows_avx2(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample411_rows_avx2(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample420_cosited_rows_avx2(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 first_row, uint32 rows);
+void halve_rows_avx2(const uint32* raster, uint32* half, const image_t* image, uint32 half_stride, uint32 rows);
+void compare_samples_avx2(const uint8* reference, const uint8* samples, uint32 n, sample_error_t* error);
+FOR_EACH_COLOR_SPACE(DECLARE_COLOR_KERNELS, avx512)
+void downsample_rows_avx512(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample_planar_rows_avx512(const uint8* ycbcr, const planes_t* planes, const image_t* image, uint32 rows);
+void downsample422_rows_avx512(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample411_rows_avx512(const uint8* ycbcr, uint8* subsampled_ycbcr, const image_t* image, uint32 rows);
+void downsample420_cosited_rows_avx512(const uint8* ycbcr, uint8* downsampled_ycbcr, const image_t* image, uint32 first_row, uint32 rows);
+void halve_rows_avx512(const uint32* raster, uint32* half, const image_t* image, uint32 half_stride, uint32 rows);
+void compare_samples_avx512(const uint8* reference, const uint8* samples, uint32 n, sample_error_t* error);
+#endif
+
+#endif //COLOR_SPACE_CONVERSION_H
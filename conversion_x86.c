@@ -0,0 +1,291 @@
+#include "conversion.h"
+
+#ifdef X86_KERNELS
+#include <immintrin.h>
+
+/**
+ * pshufb masks shared by every x86 kernel. All of them work inside one 128-bit lane, so the wider
+ * instruction sets broadcast them to every lane.
+ */
+
+// [output register][plane]: three 16 byte planes -> 48 interleaved bytes (YCbCrYCbCr...)
+static const uint8 interleave_masks[3][3][16] = {
+    {{0, 0x80, 0x80, 1, 0x80, 0x80, 2, 0x80, 0x80, 3, 0x80, 0x80, 4, 0x80, 0x80, 5},
+     {0x80, 0, 0x80, 0x80, 1, 0x80, 0x80, 2, 0x80, 0x80, 3, 0x80, 0x80, 4, 0x80, 0x80},
+     {0x80, 0x80, 0, 0x80, 0x80, 1, 0x80, 0x80, 2, 0x80, 0x80, 3, 0x80, 0x80, 4, 0x80}},
+    {{0x80, 0x80, 6, 0x80, 0x80, 7, 0x80, 0x80, 8, 0x80, 0x80, 9, 0x80, 0x80, 10, 0x80},
+     {5, 0x80, 0x80, 6, 0x80, 0x80, 7, 0x80, 0x80, 8, 0x80, 0x80, 9, 0x80, 0x80, 10},
+     {0x80, 5, 0x80, 0x80, 6, 0x80, 0x80, 7, 0x80, 0x80, 8, 0x80, 0x80, 9, 0x80, 0x80}},
+    {{0x80, 11, 0x80, 0x80, 12, 0x80, 0x80, 13, 0x80, 0x80, 14, 0x80, 0x80, 15, 0x80, 0x80},
+     {0x80, 0x80, 11, 0x80, 0x80, 12, 0x80, 0x80, 13, 0x80, 0x80, 14, 0x80, 0x80, 15, 0x80},
+     {10, 0x80, 0x80, 11, 0x80, 0x80, 12, 0x80, 0x80, 13, 0x80, 0x80, 14, 0x80, 0x80, 15}},
+};
+
+// [output register][plane]: three planes of 16-bit pairs -> Y0Y1 Y2Y3 CbCr macro-pixels (like vst3q_u16)
+static const uint8 interleave16_masks[3][3][16] = {
+    {{0, 1, 0x80, 0x80, 0x80, 0x80, 2, 3, 0x80, 0x80, 0x80, 0x80, 4, 5, 0x80, 0x80},
+     {0x80, 0x80, 0, 1, 0x80, 0x80, 0x80, 0x80, 2, 3, 0x80, 0x80, 0x80, 0x80, 4, 5},
+     {0x80, 0x80, 0x80, 0x80, 0, 1, 0x80, 0x80, 0x80, 0x80, 2, 3, 0x80, 0x80, 0x80, 0x80}},
+    {{0x80, 0x80, 6, 7, 0x80, 0x80, 0x80, 0x80, 8, 9, 0x80, 0x80, 0x80, 0x80, 10, 11},
+     {0x80, 0x80, 0x80, 0x80, 6, 7, 0x80, 0x80, 0x80, 0x80, 8, 9, 0x80, 0x80, 0x80, 0x80},
+     {4, 5, 0x80, 0x80, 0x80, 0x80, 6, 7, 0x80, 0x80, 0x80, 0x80, 8, 9, 0x80, 0x80}},
+    {{0x80, 0x80, 0x80, 0x80, 12, 13, 0x80, 0x80, 0x80, 0x80, 14, 15, 0x80, 0x80, 0x80, 0x80},
+     {10, 11, 0x80, 0x80, 0x80, 0x80, 12, 13, 0x80, 0x80, 0x80, 0x80, 14, 15, 0x80, 0x80},
+     {0x80, 0x80, 10, 11, 0x80, 0x80, 0x80, 0x80, 12, 13, 0x80, 0x80, 0x80, 0x80, 14, 15}},
+};
+
+// [input register]: gathers Y0..Y15 out of 48 interleaved YCbCr bytes
+static const uint8 y_masks[3][16] = {
+    {0, 3, 6, 9, 12, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 2, 5, 8, 11, 14, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 1, 4, 7, 10, 13},
+};
+
+// [channel][input register]: R, G or B of 16 packed RGB24 pixels (like vld3q_u8), the R masks are y_masks
+static const uint8 rgb24_masks[3][3][16] = {
+    {{0, 3, 6, 9, 12, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 2, 5, 8, 11, 14, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 1, 4, 7, 10, 13}},
+    {{1, 4, 7, 10, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0, 3, 6, 9, 12, 15, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 2, 5, 8, 11, 14}},
+    {{2, 5, 8, 11, 14, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 1, 4, 7, 10, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0, 3, 6, 9, 12, 15}},
+};
+
+// [output register][plane]: Y0..Y15, Y16..Y31 and 8 CbCr pairs -> 8 Y0Y1Y2Y3CbCr blocks of 4:1:1
+static const uint8 interleave411_masks[3][3][16] = {
+    {{0, 1, 2, 3, 0x80, 0x80, 4, 5, 6, 7, 0x80, 0x80, 8, 9, 10, 11},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0, 1, 0x80, 0x80, 0x80, 0x80, 2, 3, 0x80, 0x80, 0x80, 0x80}},
+    {{0x80, 0x80, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0, 1, 2, 3, 0x80, 0x80, 4, 5},
+     {4, 5, 0x80, 0x80, 0x80, 0x80, 6, 7, 0x80, 0x80, 0x80, 0x80, 8, 9, 0x80, 0x80}},
+    {{0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {6, 7, 0x80, 0x80, 8, 9, 10, 11, 0x80, 0x80, 12, 13, 14, 15, 0x80, 0x80},
+     {0x80, 0x80, 10, 11, 0x80, 0x80, 0x80, 0x80, 12, 13, 0x80, 0x80, 0x80, 0x80, 14, 15}},
+};
+
+// [input register]: Cb/Cr of the even pixels (Cb0 Cr0 Cb2 Cr2 ..., like vtrn1q_u8)
+static const uint8 cb_cr_even_masks[3][16] = {
+    {1, 2, 7, 8, 13, 14, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 3, 4, 9, 10, 15, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0, 5, 6, 11, 12},
+};
+
+// [input register]: Cb/Cr of the odd pixels (Cb1 Cr1 Cb3 Cr3 ..., like vtrn2q_u8)
+static const uint8 cb_cr_odd_masks[3][16] = {
+    {4, 5, 10, 11, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x80, 0x80, 0x80, 0x80, 0, 1, 6, 7, 12, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 2, 3, 8, 9, 14, 15},
+};
+
+// [even/odd][first/second register]: every other CbCr pair of two registers of 8 pairs, the first one's in the low half
+static const uint8 cb_cr_pair_masks[2][2][16] = {
+    {{0, 1, 4, 5, 8, 9, 12, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0, 1, 4, 5, 8, 9, 12, 13}},
+    {{2, 3, 6, 7, 10, 11, 14, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 2, 3, 6, 7, 10, 11, 14, 15}},
+};
+
+// [odd pairs/load one pixel earlier]: the CbCr pairs of the left neighbours of the even pixels, the odd
+// pairs moved up by one and the pixel before the block in front
+static const uint8 left_cb_cr_masks[2][16] = {
+    {0x80, 0x80, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13},
+    {1, 2, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+};
+
+
+// [plane][input register]: Y00Y01 / Y10Y11 / CbCr pairs out of 8 interleaved macro-pixels (like vld3q_u16),
+// also R, G and B of 8 RGB48 pixels
+static const uint8 deinterleave16_masks[3][3][16] = {
+    {{0, 1, 6, 7, 12, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 2, 3, 8, 9, 14, 15, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 4, 5, 10, 11}},
+    {{2, 3, 8, 9, 14, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 4, 5, 10, 11, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0, 1, 6, 7, 12, 13}},
+    {{4, 5, 10, 11, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0, 1, 6, 7, 12, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+     {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 2, 3, 8, 9, 14, 15}},
+};
+
+// [Cb/Cr][pixels 0-7/8-15]: every Cb or Cr of the CbCr pairs repeated for both pixels, as 16-bit values
+static const uint8 nearest_chroma_masks[2][2][16] = {
+    {{0, 0x80, 0, 0x80, 2, 0x80, 2, 0x80, 4, 0x80, 4, 0x80, 6, 0x80, 6, 0x80},
+     {8, 0x80, 8, 0x80, 10, 0x80, 10, 0x80, 12, 0x80, 12, 0x80, 14, 0x80, 14, 0x80}},
+    {{1, 0x80, 1, 0x80, 3, 0x80, 3, 0x80, 5, 0x80, 5, 0x80, 7, 0x80, 7, 0x80},
+     {9, 0x80, 9, 0x80, 11, 0x80, 11, 0x80, 13, 0x80, 13, 0x80, 15, 0x80, 15, 0x80}},
+};
+
+// Cb0 Cr0 Cb1 Cr1 ... -> Cb0..Cb7 in the low half of the lane, Cr0..Cr7 in the high half
+static const uint8 cb_cr_split_mask[16] = {0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15};
+
+/**
+ * [RGB48/RGBA64][R G pairs/B][first/second load]: 4 pixels of 16-bit samples as R0 G0 R1 G1 ... and
+ * B0 0 B1 0 ... for pmaddwd, out of two overlapping loads 8 (RGB48) or 16 (RGBA64) bytes apart
+ */
+static const uint8 rgb48_masks[2][2][2][16] = {
+    {{{0, 1, 2, 3, 6, 7, 8, 9, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80},
+      {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 10, 11, 12, 13}},
+     {{4, 5, 0x80, 0x80, 10, 11, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+      {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 8, 9, 0x80, 0x80, 14, 15, 0x80, 0x80}}},
+    {{{0, 1, 2, 3, 8, 9, 10, 11, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+      {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0, 1, 2, 3, 8, 9, 10, 11}},
+     {{4, 5, 0x80, 0x80, 12, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+      {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 4, 5, 0x80, 0x80, 12, 13, 0x80, 0x80}}},
+};
+
+// Two signed 16-bit weights in every 32-bit lane, the low one multiplies the even samples of pmaddwd
+#define WEIGHT_PAIR(low, high) ((int) ((uint32) (uint16) (high) << 16 | (uint16) (low)))
+
+
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+
+// Lane k of the register comes from / goes to p + k * stride
+TARGET_AVX2 static inline __m256i load_lanes_avx2(const uint8* p, size_t stride){
+    __m256i v = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) p));
+    return _mm256_inserti128_si256(v, _mm_loadu_si128((const __m128i*) (p + stride)), 1);
+}
+
+TARGET_AVX2 static inline void store_lanes_avx2(uint8* p, size_t stride, __m256i v){
+    _mm_storeu_si128((__m128i*) p, _mm256_castsi256_si128(v));
+    _mm_storeu_si128((__m128i*) (p + stride), _mm256_extracti128_si256(v, 1));
+}
+
+// Low 64 bits of every lane go to low, the high 64 bits to high
+TARGET_SSE41 static inline void store_halves_sse41(uint8* low, uint8* high, __m128i v){
+    _mm_storel_epi64((__m128i*) low, v);
+    _mm_storel_epi64((__m128i*) high, _mm_unpackhi_epi64(v, v));
+}
+
+TARGET_AVX2 static inline void store_halves_avx2(uint8* low, uint8* high, __m256i v){
+    v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128((__m128i*) low, _mm256_castsi256_si128(v));
+    _mm_storeu_si128((__m128i*) high, _mm256_extracti128_si256(v, 1));
+}
+
+TARGET_AVX512 static inline __m512i load_lanes_avx512(const uint8* p, size_t stride){
+    __m512i v = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*) p));
+    v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*) (p + stride)), 1);
+    v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*) (p + 2 * stride)), 2);
+    return _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*) (p + 3 * stride)), 3);
+}
+
+TARGET_AVX512 static inline void store_lanes_avx512(uint8* p, size_t stride, __m512i v){
+    _mm_storeu_si128((__m128i*) p, _mm512_castsi512_si128(v));
+    _mm_storeu_si128((__m128i*) (p + stride), _mm512_extracti32x4_epi32(v, 1));
+    _mm_storeu_si128((__m128i*) (p + 2 * stride), _mm512_extracti32x4_epi32(v, 2));
+    _mm_storeu_si128((__m128i*) (p + 3 * stride), _mm512_extracti32x4_epi32(v, 3));
+}
+
+TARGET_AVX512 static inline void store_halves_avx512(uint8* low, uint8* high, __m512i v){
+    v = _mm512_permutexvar_epi64(_mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0), v);
+    _mm256_storeu_si256((__m256i*) low, _mm512_castsi512_si256(v));
+    _mm256_storeu_si256((__m256i*) high, _mm512_extracti64x4_epi64(v, 1));
+}
+
+// Non-temporal versions of the stores above, every address has to be aligned to the size of its store
+TARGET_SSE41 static inline void stream_halves_sse41(uint8* low, uint8* high, __m128i v){
+    _mm_stream_si64((long long*) low, _mm_cvtsi128_si64(v));
+    _mm_stream_si64((long long*) high, _mm_extract_epi64(v, 1));
+}
+
+TARGET_AVX2 static inline void stream_lanes_avx2(uint8* p, size_t stride, __m256i v){
+    _mm_stream_si128((__m128i*) p, _mm256_castsi256_si128(v));
+    _mm_stream_si128((__m128i*) (p + stride), _mm256_extracti128_si256(v, 1));
+}
+
+TARGET_AVX2 static inline void stream_halves_avx2(uint8* low, uint8* high, __m256i v){
+    v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_stream_si128((__m128i*) low, _mm256_castsi256_si128(v));
+    _mm_stream_si128((__m128i*) high, _mm256_extracti128_si256(v, 1));
+}
+
+TARGET_AVX512 static inline void stream_lanes_avx512(uint8* p, size_t stride, __m512i v){
+    _mm_stream_si128((__m128i*) p, _mm512_castsi512_si128(v));
+    _mm_stream_si128((__m128i*) (p + stride), _mm512_extracti32x4_epi32(v, 1));
+    _mm_stream_si128((__m128i*) (p + 2 * stride), _mm512_extracti32x4_epi32(v, 2));
+    _mm_stream_si128((__m128i*) (p + 3 * stride), _mm512_extracti32x4_epi32(v, 3));
+}
+
+TARGET_AVX512 static inline void stream_halves_avx512(uint8* low, uint8* high, __m512i v){
+    v = _mm512_permutexvar_epi64(_mm512_set_epi64(7, 5, 3, 1, 6, 4, 2, 0), v);
+    _mm256_stream_si256((__m256i*) low, _mm512_castsi512_si256(v));
+    _mm256_stream_si256((__m256i*) high, _mm512_extracti64x4_epi64(v, 1));
+}
+
+// Large-frame mode writes p with non-temporal stores when it has the alignment they need
+static inline bool stream_to(const uint8* p, size_t alignment){
+    return large_frames && ((uintptr_t) p & (alignment - 1)) == 0;
+}
+
+// Prefetches the lines of the n bytes PREFETCH_DISTANCE past p, the input of a block further down the row
+static inline void prefetch_ahead(const uint8* p, size_t n){
+    for (size_t offset = 0; offset < n; offset += CACHELINE_SZ) {
+        _mm_prefetch((const char*) (p + PREFETCH_DISTANCE + offset), _MM_HINT_T0);
+    }
+}
+
+
+// SSE4.1, 16 pixels per iteration
+#define SUFFIX sse41
+#define FALLBACK scalar
+#define TARGET TARGET_SSE41
+#define LANES 1
+#define vec_t __m128i
+#define V(op) _mm_##op
+#define V_AND _mm_and_si128
+#define V_OR _mm_or_si128
+#define V_MASK(mask) _mm_loadu_si128((const __m128i*) (mask))
+#define V_LOAD_LANES(p, stride) _mm_loadu_si128((const __m128i*) (p))
+#define V_STORE_LANES(p, stride, v) _mm_storeu_si128((__m128i*) (p), v)
+#define V_STORE(p, v) _mm_storeu_si128((__m128i*) (p), v)
+#define V_STORE_HALVES(low, high, v) store_halves_sse41(low, high, v)
+#define V_STREAM_LANES(p, stride, v) _mm_stream_si128((__m128i*) (p), v)
+#define V_STREAM(p, v) _mm_stream_si128((__m128i*) (p), v)
+#define V_STREAM_HALVES(low, high, v) stream_halves_sse41(low, high, v)
+#include "conversion_x86.inc"
+
+// AVX2, 32 pixels per iteration
+#define SUFFIX avx2
+#define FALLBACK sse41
+#define TARGET TARGET_AVX2
+#define LANES 2
+#define vec_t __m256i
+#define V(op) _mm256_##op
+#define V_AND _mm256_and_si256
+#define V_OR _mm256_or_si256
+#define V_MASK(mask) _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) (mask)))
+#define V_LOAD_LANES(p, stride) load_lanes_avx2(p, stride)
+#define V_STORE_LANES(p, stride, v) store_lanes_avx2(p, stride, v)
+#define V_STORE(p, v) _mm256_storeu_si256((__m256i*) (p), v)
+#define V_STORE_HALVES(low, high, v) store_halves_avx2(low, high, v)
+#define V_STREAM_LANES(p, stride, v) stream_lanes_avx2(p, stride, v)
+#define V_STREAM(p, v) _mm256_stream_si256((__m256i*) (p), v)
+#define V_STREAM_HALVES(low, high, v) stream_halves_avx2(low, high, v)
+#include "conversion_x86.inc"
+
+// AVX-512BW, 64 pixels per iteration
+#define SUFFIX avx512
+#define FALLBACK avx2
+#define TARGET TARGET_AVX512
+#define LANES 4
+#define vec_t __m512i
+#define V(op) _mm512_##op
+#define V_AND _mm512_and_si512
+#define V_OR _mm512_or_si512
+#define V_MASK(mask) _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*) (mask)))
+#define V_LOAD_LANES(p, stride) load_lanes_avx512(p, stride)
+#define V_STORE_LANES(p, stride, v) store_lanes_avx512(p, stride, v)
+#define V_STORE(p, v) _mm512_storeu_si512((void*) (p), v)
+#define V_STORE_HALVES(low, high, v) store_halves_avx512(low, high, v)
+#define V_STREAM_LANES(p, stride, v) stream_lanes_avx512(p, stride, v)
+#define V_STREAM(p, v) _mm512_stream_si512((void*) (p), v)
+#define V_STREAM_HALVES(low, high, v) stream_halves_avx512(low, high, v)
+#include "conversion_x86.inc"
+
+#endif
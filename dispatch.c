@@ -0,0 +1,144 @@
+#include <string.h>
+#include "conversion.h"
+
+// One table per color space, in COLOR_SPACE_INDEX order
+#define KERNEL_TABLE(color, name, isa) { \
+    name, convert_rows_##color##_##isa, convert48_rows_##color##_##isa, convert48_precise_rows_##color##_##isa, \
+    downsample_rows_##isa, convert420_rows_##color##_##isa, downsample_planar_rows_##isa, \
+    downsample422_rows_##isa, downsample411_rows_##isa, downsample420_cosited_rows_##isa, \
+    convert420_planar_rows_##color##_##isa, convert_packed_rows_##color##_##isa, convert420_planar_packed_rows_##color##_##isa, \
+    halve_rows_##isa, convert420_to_rgb_rows_##color##_##isa, compare_samples_##isa \
+},
+
+const kernel_table_t scalar_kernels[COLOR_SPACES] = {
+    FOR_EACH_COLOR_SPACE(KERNEL_TABLE, "scalar", scalar)
+};
+
+#ifdef __ARM_NEON
+static const kernel_table_t neon_kernels[COLOR_SPACES] = {
+    FOR_EACH_COLOR_SPACE(KERNEL_TABLE, "NEON", neon)
+};
+#endif
+
+#ifdef X86_KERNELS
+static const kernel_table_t sse41_kernels[COLOR_SPACES] = {
+    FOR_EACH_COLOR_SPACE(KERNEL_TABLE, "SSE4.1", sse41)
+};
+static const kernel_table_t avx2_kernels[COLOR_SPACES] = {
+    FOR_EACH_COLOR_SPACE(KERNEL_TABLE, "AVX2", avx2)
+};
+static const kernel_table_t avx512_kernels[COLOR_SPACES] = {
+    FOR_EACH_COLOR_SPACE(KERNEL_TABLE, "AVX-512", avx512)
+};
+#endif
+
+static const char* const matrix_names[3] = {"bt601", "bt709", "bt2020"};
+
+const subsampling_mode_t subsampling_modes[SUBSAMPLING_MODES] = {
+    {"420", 2, 2, YCBCRPOSITION_CENTERED},
+    {"422", 2, 1, YCBCRPOSITION_CENTERED},
+    {"411", 4, 1, YCBCRPOSITION_CENTERED},
+    {"444", 1, 1, YCBCRPOSITION_CENTERED},
+    {"420-cosited", 2, 2, YCBCRPOSITION_COSITED},
+};
+
+const pixel_format_info_t pixel_formats[PIXEL_FORMATS] = {
+    {"rgba", 4},
+    {"bgra", 4},
+    {"rgb24", 3},
+    {"rgb48le", 6},
+};
+
+// Tables of the instruction set picked by select_kernels()
+static const kernel_table_t* isa_kernels = scalar_kernels;
+
+color_space_t color_space = {MATRIX_BT601, RANGE_STUDIO};
+const kernel_table_t* kernels = &scalar_kernels[0];
+bool large_frames = false;
+
+
+// Every instruction set the CPU supports by CPUID on x86, NEON is a build-time choice on ARM
+uint32 supported_kernels(const kernel_table_t** tables){
+    uint32 n_tables = 0;
+#if defined(__ARM_NEON)
+    tables[n_tables++] = neon_kernels;
+#elif defined(X86_KERNELS)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        tables[n_tables++] = avx512_kernels;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        tables[n_tables++] = avx2_kernels;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        tables[n_tables++] = sse41_kernels;
+    }
+#endif
+    tables[n_tables++] = scalar_kernels;
+    return n_tables;
+}
+
+
+// Picks the widest kernels the CPU supports
+void select_kernels(void){
+    const kernel_table_t* tables[ISA_KERNELS];
+    supported_kernels(tables);
+    select_isa_kernels(tables[0]);
+}
+
+
+void select_isa_kernels(const kernel_table_t* tables){
+    isa_kernels = tables;
+    kernels = &isa_kernels[COLOR_SPACE_INDEX(&color_space)];
+}
+
+
+// Same instruction set, kernels generated for the color space; no per-pixel choice is left in them
+void select_color_space(const color_space_t* space){
+    color_space = *space;
+    kernels = &isa_kernels[COLOR_SPACE_INDEX(&color_space)];
+}
+
+
+bool parse_color_space(const char* name, color_space_t* space){
+    for (int matrix = 0; matrix < 3; ++matrix) {
+        size_t length = strlen(matrix_names[matrix]);
+        if (strncmp(name, matrix_names[matrix], length) != 0) {
+            continue;
+        }
+        if (name[length] == '\0' || strcmp(name + length, "-full") == 0) {
+            space->matrix = (color_matrix_t) matrix;
+            space->range = name[length] == '\0' ? RANGE_STUDIO : RANGE_FULL;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+const char* color_space_name(const color_space_t* space){
+    static const char* const names[COLOR_SPACES] = {"bt601", "bt601-full", "bt709", "bt709-full", "bt2020", "bt2020-full"};
+    return names[COLOR_SPACE_INDEX(space)];
+}
+
+
+bool parse_subsampling(const char* name, subsampling_t* subsampling){
+    for (int mode = 0; mode < SUBSAMPLING_MODES; ++mode) {
+        if (strcmp(name, subsampling_modes[mode].name) == 0) {
+            *subsampling = (subsampling_t) mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool parse_pixel_format(const char* name, pixel_format_t* format){
+    for (int i = 0; i < PIXEL_FORMATS; ++i) {
+        if (strcmp(name, pixel_formats[i].name) == 0) {
+            *format = (pixel_format_t) i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,114 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "conversion.h"
+#include "frame_pool.h"
+
+struct frame_pool{
+    uint8** frames;             // stack of free frames
+    uint8** all_frames;
+    uint32 n_frames;
+    uint32 n_free;
+    size_t frame_size;
+    pthread_mutex_t lock;
+    pthread_cond_t returned;
+};
+
+
+uint8* frame_alloc(size_t size){
+    void* frame = NULL;
+    // rounded up to whole cache lines so neighbouring frames never share one
+    size_t alignment = CACHELINE_SZ;
+
+    // in large-frame mode whole huge pages, so the last one is not left to small pages either
+    if (large_frames && size >= HUGE_PAGE_SZ) {
+        alignment = HUGE_PAGE_SZ;
+    }
+    size = (size + alignment - 1) & ~(alignment - 1);
+    if (posix_memalign(&frame, alignment, size) != 0) {
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    // with transparent huge pages set to madvise only advised ranges get them, the pages still go back with free()
+    if (alignment == HUGE_PAGE_SZ) {
+        madvise(frame, size, MADV_HUGEPAGE);
+    }
+#endif
+    return (uint8*) frame;
+}
+
+
+frame_pool_t* frame_pool_create(size_t frame_size, uint32 n_frames){
+    frame_pool_t* pool = calloc(1, sizeof(frame_pool_t));
+    if (pool == NULL) {
+        printf("[-] \033[0;31mCould not allocate the frame pool\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pool->frames = malloc(sizeof(uint8*) * n_frames);
+    pool->all_frames = malloc(sizeof(uint8*) * n_frames);
+    if (pool->frames == NULL || pool->all_frames == NULL) {
+        printf("[-] \033[0;31mCould not allocate the frame pool\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+    pool->n_frames = n_frames;
+    pool->n_free = n_frames;
+    pool->frame_size = frame_size;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->returned, NULL);
+
+    for (uint32 i = 0; i < n_frames; ++i) {
+        pool->all_frames[i] = pool->frames[i] = frame_alloc(frame_size);
+        if (pool->frames[i] == NULL) {
+            printf("[-] \033[0;31mCould not allocate the frame pool\033[0m\n");
+            exit(EXIT_FAILURE);
+        }
+        // fault every page in now rather than in the first frames
+        memset(pool->frames[i], 0, frame_size);
+    }
+
+    return pool;
+}
+
+
+void frame_pool_destroy(frame_pool_t* pool){
+    if (pool == NULL) {
+        return;
+    }
+    for (uint32 i = 0; i < pool->n_frames; ++i) {
+        free(pool->all_frames[i]);
+    }
+    pthread_cond_destroy(&pool->returned);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->all_frames);
+    free(pool->frames);
+    free(pool);
+}
+
+
+size_t frame_pool_frame_size(const frame_pool_t* pool){
+    return pool->frame_size;
+}
+
+
+uint8* frame_pool_get(frame_pool_t* pool){
+    pthread_mutex_lock(&pool->lock);
+    while (pool->n_free == 0) {
+        pthread_cond_wait(&pool->returned, &pool->lock);
+    }
+    // last returned first out, its lines are the most likely to still be cached
+    uint8* frame = pool->frames[--pool->n_free];
+    pthread_mutex_unlock(&pool->lock);
+    return frame;
+}
+
+
+void frame_pool_put(frame_pool_t* pool, uint8* frame){
+    pthread_mutex_lock(&pool->lock);
+    pool->frames[pool->n_free++] = frame;
+    pthread_cond_signal(&pool->returned);
+    pthread_mutex_unlock(&pool->lock);
+}
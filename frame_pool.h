@@ -0,0 +1,25 @@
+#ifndef COLOR_SPACE_CONVERSION_FRAME_POOL_H
+#define COLOR_SPACE_CONVERSION_FRAME_POOL_H
+
+#include <stddef.h>
+#include <tiffio.h>
+
+/**
+ * Fixed set of equally sized, cache-line aligned frames that are handed out and given back for every
+ * video frame. The frames are touched once when the pool is created, so the steady state does no
+ * allocation and takes no page faults.
+ */
+typedef struct frame_pool frame_pool_t;
+
+// Cache-line aligned frame of at least size bytes, on huge pages in large-frame mode; released with free()
+uint8* frame_alloc(size_t size);
+
+frame_pool_t* frame_pool_create(size_t frame_size, uint32 n_frames);
+void frame_pool_destroy(frame_pool_t* pool);
+size_t frame_pool_frame_size(const frame_pool_t* pool);
+
+// Takes a free frame, waiting for frame_pool_put() when all of them are in use
+uint8* frame_pool_get(frame_pool_t* pool);
+void frame_pool_put(frame_pool_t* pool, uint8* frame);
+
+#endif //COLOR_SPACE_CONVERSION_FRAME_POOL_H
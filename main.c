@@ -9,608 +9,510 @@
 #include <unistd.h>
 #include <sched.h>
 #include <sys/time.h>
-#include <arm_neon.h>
+#include <sys/resource.h>
+#include "conversion.h"
+#include "thread_pool.h"
+#include "frame_pool.h"
+#include "batch.h"
+#include "accuracy.h"
+#include "profile.h"
 
-#ifdef DEBUG
-#define DEBUG_PRINT(fmt, args...)    fprintf(stderr, fmt, args)
-#else
-#define DEBUG_PRINT(fmt, args...)
-#endif
-
-#define Y(var, i, offset, position) var[i*offset]
-#define Cb(var, i, offset, position) var[i*offset+position]
-#define Cr(var, i, offset, position) var[i*offset+position]
-#define CACHELINE_SZ 64
+// Frames converted per thread count by measureScaling
+#define SCALING_FRAMES 20
 
 volatile int completed[3]={0,0,0};
 
-typedef struct data{
-    uint8* conv_segment;
-    uint32* segment;
-} worker_data_t;
-
-
-uint32 * read_tiff_image(char* filename){
-    printf("[+] Opening \033[1;36m%s\033[0m\n", filename);
-    TIFF* tiff_image = TIFFOpen(filename, "r");
-    if (!tiff_image) {
-        printf("[-] \033[0;31mCould not open %s for conversion\033[0m", filename);
-        exit(EXIT_FAILURE);
-    }
-    size_t n_pixels = 640 * 480;
-    uint32* image_data = (uint32*) malloc(n_pixels * sizeof(uint32));
-
 
-    if (image_data == NULL){
-        printf("[-] \033[0;31mCould not allocate memory to store image file\033[0m\n");
+// frame_alloc() that gives up on the demo when the frame does not fit
+static void* allocateFrame(size_t size){
+    uint8* frame = frame_alloc(size);
+    if (frame == NULL) {
+        printf("[-] \033[0;31mCould not allocate a frame of %zu bytes\033[0m\n", size);
         exit(EXIT_FAILURE);
     }
-    printf("[o] Reading Image\n");
-    TIFFReadRGBAImageOriented(tiff_image, 640, 480, image_data,	ORIENTATION_TOPLEFT, 0);
-    TIFFClose(tiff_image);
-
-    printf("[+] \033[1;32mSuccessfully read image to memory\033[0m\n");
-
-
-    return image_data;
+    return frame;
 }
 
 
-void write_tiff_image(uint8 *image, char* filename, int width, int height, int cb_subsampling, int cr_subsampling) {
-    // printf("[+] Creating output file \033[1;36m%s\033[0m\n", filename);
-    char* f = calloc(100, sizeof(char));
-    char* ext = ".tiff";
-    strcat(f, filename);
-    strcat(f, ext);
-    TIFF* tiff_output = TIFFOpen(f, "w");
-    int chroma_values = 2;
-    int n_samples = 6;
-
-    if (!tiff_output){
-        printf("[-] \033[0;31mCould not create %s\033[0m\n", filename);
-        exit(EXIT_FAILURE);
-    }
-
-    //printf("[o] Setting TIFF Tags\n");
-    TIFFSetField(tiff_output, TIFFTAG_IMAGEWIDTH, width);
-    TIFFSetField(tiff_output, TIFFTAG_IMAGELENGTH, height);
-    TIFFSetField(tiff_output, TIFFTAG_SAMPLESPERPIXEL, 3);
-    TIFFSetField(tiff_output, TIFFTAG_BITSPERSAMPLE, 8);
-    TIFFSetField(tiff_output, TIFFTAG_ORIENTATION, (int)ORIENTATION_BOTLEFT);
-    TIFFSetField(tiff_output, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-    TIFFSetField(tiff_output, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
-    TIFFSetField(tiff_output, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_YCBCR);
-    TIFFSetField(tiff_output, TIFFTAG_YCBCRSUBSAMPLING, 2, 2);
-    TIFFSetField(tiff_output, TIFFTAG_YCBCRPOSITIONING, YCBCRPOSITION_COSITED);
-    //printf("[+] \033[1;32mSuccessfully Set TIFF Tags\033[0m\n");
-
-
-    size_t bytes_per_line = TIFFScanlineSize(tiff_output); //adjust for subsampling
-    uint8* buffer = malloc(bytes_per_line);
-
-    //printf("[o] Writing TIFF Image\n");
-    for (int row = 0; row < height; ++row) {
-        memcpy(buffer, &image[row * bytes_per_line], bytes_per_line);
-        if (TIFFWriteScanline(tiff_output, buffer, row, 0) < 0){
-            printf("[-] \033[0;31mWriting data failed!\033[0m\n");
-            exit(EXIT_FAILURE);
-        }
-    }
-
-    //printf("[+] \033[1;32mSuccessfully Wrote TIFF Image\033[0m\n");
-    free(buffer);
-    TIFFClose(tiff_output);
+// Checks a frame against the floating-point reference of its path and prints the errors under the timing
+static void printAccuracy(uint8* reference, frame_format_t reference_format, const void* frame, frame_format_t format, const image_t* image){
+    frame_error_t error;
+    compare_frames(reference, reference_format, frame, format, image, &error);
+    print_frame_error(stdout, &error);
+    free(reference);
 }
 
 
-// Simple implementation, accessing two rows at a time (benchmark)
-uint8* downsample_ycbcr(const uint8* ycbcr){
-    uint32 width = 640;
-    uint32 height = 480;
-    uint8* downsampled_ycbcr = malloc(width * height * 3 / 2);
-    uint32 row_size = width * 3;
-
-    int downsampled_pixel = 0;
-    for (int pixel = 0; pixel < (width * height * 3); pixel+=6) {
-        // if(start of next row)
-        //      skip the next row since we have already processed its data
-        if(pixel != 0 && pixel % row_size == 0) {
-            pixel+=row_size;
-        }
-
-        // store y00,y01,y10,y11,avg(cb00,cb01,cb10,cb11),avg(cr00,cr01,cr10,cr11)
-        downsampled_ycbcr[downsampled_pixel] = ycbcr[pixel]; //y00
-        downsampled_ycbcr[downsampled_pixel+1] = ycbcr[pixel+3]; //y01
-        downsampled_ycbcr[downsampled_pixel+2] = ycbcr[pixel+row_size]; //y10
-        downsampled_ycbcr[downsampled_pixel+3] = ycbcr[pixel+row_size+3]; //y11
-        int cbSum = ycbcr[pixel+1] + ycbcr[pixel+4] + ycbcr[pixel+row_size+1] + ycbcr[pixel+row_size+4];
-        downsampled_ycbcr[downsampled_pixel+4] = (uint8)(cbSum/4); // avg(cb00,cb01,cb10,cb11)
-        int crSum = ycbcr[pixel+2] + ycbcr[pixel+5] + ycbcr[pixel+row_size+2] + ycbcr[pixel+row_size+5];
-        downsampled_ycbcr[downsampled_pixel+5] = (uint8)(crSum/4); // avg(cr00,cr01,cr10,cr11)
-
-        downsampled_pixel+=6;
-    }
-
+// Floating-point RGB -> 4:4:4 conversion followed by the plain 2x2 average
+static uint8* reference420(const uint32* raster, const image_t* image){
+    uint8* ycbcr = convert_rgb_to_ycbcr(raster, image);
+    uint8* downsampled_ycbcr = downsample_ycbcr(ycbcr, image);
+    free(ycbcr);
     return downsampled_ycbcr;
 }
 
 
-// Simple implementation, using bit shifting instead of division
-uint8* downsample_ycbcr_v1(const uint8* ycbcr){
-    uint32 width = 640;
-    uint32 height = 480;
-    uint8* downsampled_ycbcr = malloc(width * height * 3 / 2);
-    uint32 row_size = width * 3;
-
-    int downsampled_pixel = 0;
-    for (int pixel = 0; pixel < (width * height * 3); pixel+=6) {
-        // if(start of next row)
-        //      skip the next row since we have already processed its data
-        if(pixel != 0 && pixel % row_size == 0) {
-            pixel+=row_size;
-        }
-
-        // store y00,y01,y10,y11,avg(cb00,cb01,cb10,cb11),avg(cr00,cr01,cr10,cr11)
-        downsampled_ycbcr[downsampled_pixel] = ycbcr[pixel]; //y00
-        downsampled_ycbcr[downsampled_pixel+1] = ycbcr[pixel+3]; //y01
-        downsampled_ycbcr[downsampled_pixel+2] = ycbcr[pixel+row_size]; //y10
-        downsampled_ycbcr[downsampled_pixel+3] = ycbcr[pixel+row_size+3]; //y11
-        downsampled_ycbcr[downsampled_pixel+4] = (uint8)((ycbcr[pixel+1] + ycbcr[pixel+4] + ycbcr[pixel+row_size+1] + ycbcr[pixel+row_size+4]) >> 2); // avg(cb00,cb01,cb10,cb11)
-        downsampled_ycbcr[downsampled_pixel+5] = (uint8)((ycbcr[pixel+2] + ycbcr[pixel+5] + ycbcr[pixel+row_size+2] + ycbcr[pixel+row_size+5]) >> 2); // avg(cr00,cr01,cr10,cr11)
-
-        downsampled_pixel+=6;
-    }
-
-    return downsampled_ycbcr;
+// The first fixed-point kernels have the BT.601 studio-range constants built in, any other -y would mislabel them
+static bool fixedPointColorSpace(void){
+    return color_space.matrix == MATRIX_BT601 && color_space.range == RANGE_STUDIO;
 }
 
 
-// Accessing one row at a time and back filling, hoping for less cache misses.
-uint8* downsample_ycbcr_v2(const uint8* ycbcr){
-    uint32 width = 640;
-    uint32 height = 480;
-    uint32 row_size = width * 3;
-    uint8* downsampled_ycbcr = malloc(width * height * 3 / 2);
-    bool backfill = false;
-    register int temp_cb, temp_cr;
-
-    int downsampled_pixel = 0;
-    for (int pixel = 0; pixel < width * height * 3; pixel+=6) {
-        // if(start of next row)
-        //      change fill type
-        if(pixel != 0 && pixel % row_size == 0) {
-            backfill = !backfill;
-            downsampled_pixel -= backfill ? row_size : 0;
-        }
-
-        if (!backfill){
-            // if(first row to downsample)
-            //      store y00,y01,_,_,sum(cb00,cb01),sum(cr00,cr01)
-            downsampled_ycbcr[downsampled_pixel] = ycbcr[pixel];
-            downsampled_ycbcr[downsampled_pixel+1] = ycbcr[pixel+3];
-            temp_cb = (ycbcr[pixel+1] + ycbcr[pixel+4]);
-            temp_cb = (ycbcr[pixel+2] + ycbcr[pixel+5]);
-        }
-        else if (backfill){
-            // if(second row to downsample)
-            //      store _,_,y10,y11,avg(cb00,cb01,cb10,cb11),avg(cr00,cr01,cr10,cr11)
-            downsampled_ycbcr[downsampled_pixel+2] = ycbcr[pixel];
-            downsampled_ycbcr[downsampled_pixel+3] = ycbcr[pixel+3];
-            downsampled_ycbcr[downsampled_pixel+4] = (ycbcr[pixel+1] + ycbcr[pixel+4] + temp_cb) >> 2;
-            downsampled_ycbcr[downsampled_pixel+5] = (ycbcr[pixel+2] + ycbcr[pixel+5] + temp_cr) >> 2;
-        }
-
-        downsampled_pixel+=6;
-    }
-
-    return downsampled_ycbcr;
+void measureConversion(uint8*(convert)(const uint32*, const image_t*), const uint32* raster, const image_t* image, char* tag){
+    struct timeval stop, start;
+    gettimeofday(&start, NULL);
+    uint8* ycbcr = convert(raster, image);
+    gettimeofday(&stop, NULL);
+    uint64 delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
+    printf("\033[1;36m[%s]\033[0m RGB TO YCbCr Conversion took \033[1;36m%lu\033[0m microseconds\n", tag, delta);
+    printAccuracy(convert_rgb_to_ycbcr(raster, image), FRAME_YCBCR, ycbcr, FRAME_YCBCR, image);
+    write_tiff_image(ycbcr, tag, image, SUBSAMPLING_444);
+    free(ycbcr);
 }
 
 
-//SIMD approach to the 2 rows at a time technique
-uint8* downsample_ycbcr_simd(const uint8* ycbcr){
-    uint16 image_width = 640;
-    uint16 image_height = 480;
-    uint8 pixel_depth = 3;
-    uint8* downsampled_ycbcr = (uint8*) malloc(image_width * image_height * pixel_depth / 2);
-    uint32 row_size = image_width * 3;
-    uint8x16x3_t row_i, row_j;
-    uint8x16_t row_i_cb_cr_even, row_i_cb_cr_odd, row_j_cb_cr_even, row_j_cb_cr_odd, row_i_cb_cr_avg, row_j_cb_cr_avg, cb_cr_avg;
-    uint16x8x3_t values;
-
-    int downsampled_idx = 0;
-    for (int idx = 0; idx < image_width * image_height * pixel_depth - row_size; idx+=48) {
-        // if(start of next row)
-        //      skip the next row since we have already processed its data
-        if(idx != 0 && idx % row_size == 0) {
-            idx+=row_size;
-        }
-
-        // load row_i and row_i+1
-        row_i = vld3q_u8(ycbcr+idx);
-        row_j = vld3q_u8(ycbcr+idx+row_size);
-
-        // interleve cb/cr
-        row_i_cb_cr_even = vtrn1q_u8(row_i.val[1], row_i.val[2]);
-        row_i_cb_cr_odd = vtrn2q_u8(row_i.val[1], row_i.val[2]);
-        row_j_cb_cr_even = vtrn1q_u8(row_j.val[1], row_j.val[2]);
-        row_j_cb_cr_odd = vtrn2q_u8(row_j.val[1], row_j.val[2]);
-
-        // avg
-        row_i_cb_cr_avg = vrhaddq_u8(row_i_cb_cr_even, row_i_cb_cr_odd);
-        row_j_cb_cr_avg = vrhaddq_u8(row_j_cb_cr_even, row_j_cb_cr_odd);
-        cb_cr_avg = vrhaddq_u8(row_i_cb_cr_avg, row_j_cb_cr_avg);
-
-        // reinterpret to 16x8_3_t vector array
-        values.val[0] = vreinterpretq_u16_u8(row_i.val[0]);
-        values.val[1] = vreinterpretq_u16_u8(row_j.val[0]);
-        values.val[2] = vreinterpretq_u16_u8(cb_cr_avg);
-
-        // store and interleave arrays of 16x8x3_t vector
-        vst3q_u16((downsampled_ycbcr + downsampled_idx), values);
-
-        downsampled_idx+=48;
-    }
-
-    return (uint8*) downsampled_ycbcr;
+void measureConversion48(uint8*(convert)(const uint16*, const image_t*), const uint16* rgb, const image_t* image, char* tag){
+    struct timeval stop, start;
+    gettimeofday(&start, NULL);
+    uint8* ycbcr = convert(rgb, image);
+    gettimeofday(&stop, NULL);
+    uint64 delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
+    printf("\033[1;36m[%s]\033[0m RGB TO YCbCr Conversion took \033[1;36m%lu\033[0m microseconds\n", tag, delta);
+    uint8* reference = allocateFrame(YCBCR_FRAME_SIZE(image));
+    convert_rgb48_to_ycbcr_into(rgb, reference, image);
+    printAccuracy(reference, FRAME_YCBCR, ycbcr, FRAME_YCBCR, image);
+    write_tiff_image(ycbcr, tag, image, SUBSAMPLING_444);
+    free(ycbcr);
 }
 
 
-uint8 *convert_rgb_to_ycbcr(uint32 *raster) {
-
-    /**
-     * The image is currently stored as ARGB,ARGB,ARGB format we can take the first element
-     * shift it by 8 to get B, by 16 to get G and 32 to get R
-     */
-    uint32 width = 640;
-    uint32 height = 480;
-    uint8* ycbcr = malloc(width * height * 3);
-    for (int pixel = 0; pixel < width * height; ++pixel) {
-        //DEBUG_PRINT("[o] Converting Pixel %d: [\033[1;31mRed: %d \033[1;32mGreen: %d \033[1;34mBlue: %d\033[0m]\n", pixel, TIFFGetR(raster[pixel]), TIFFGetG(raster[pixel]), TIFFGetB(raster[pixel]));
-        Y(ycbcr, pixel, 3,  0) = (0.257 * TIFFGetR(raster[pixel])) + (0.504 * TIFFGetG(raster[pixel])) + (0.098 * TIFFGetB(raster[pixel])) + 16;
-        Cb(ycbcr, pixel, 3, 1) = (-0.148 * TIFFGetR(raster[pixel])) - (0.291 * TIFFGetG(raster[pixel])) + (0.439 * TIFFGetB(raster[pixel])) + 128;
-        Cr(ycbcr, pixel, 3, 2) = (0.439 * TIFFGetR(raster[pixel])) - (0.368 * TIFFGetG(raster[pixel])) - (0.071 * TIFFGetB(raster[pixel])) + 128;
-
-        //printf("[o] Converting RGB to YCbCr: \033[1;36m%0.00f%%\033[0m \b\r", ((float) pixel/ (float) (width * height)) * 100);
-        //DEBUG_PRINT("[+] Converted Pixel %d: [\033[1;37mY: %d \033[1;36mCb: %d \033[1;35mCr: %d\033[0m]\n", pixel, Y(ycbcr, pixel), Cb(ycbcr, pixel), Cr(ycbcr, pixel));
-    }
-    return ycbcr;
+void measureDownsampling(uint8*(convert)(const uint32*, const image_t*), uint8*(downsample)(const uint8*, const image_t*), const uint32* raster, const image_t* image, char* tag){
+    struct timeval stop, start;
+    uint8* ycbcr = convert(raster, image);
+    gettimeofday(&start, NULL);
+    uint8* downsampled_ycbcr = downsample(ycbcr, image);
+    gettimeofday(&stop, NULL);
+    uint64 delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
+    printf("\033[1;36m[%s]\033[0m Downsampling took \033[1;36m%lu\033[0m microseconds\n", tag, delta);
+    printAccuracy(downsample_ycbcr(ycbcr, image), FRAME_YCBCR420, downsampled_ycbcr, FRAME_YCBCR420, image);
+    write_tiff_image(downsampled_ycbcr, tag, image, SUBSAMPLING_420);
+    free(downsampled_ycbcr);
+    free(ycbcr);
 }
 
 
-uint8* convert_rgb_to_ycbcr_v1(const uint32 *raster){
-
-    uint32 num_pixels = 640 * 480;
-    uint8* ycbcr = malloc(num_pixels*3);
-
-    for (int i = 0; i < num_pixels; ++i) {
-        Y(ycbcr, i, 3,  0)= 16 + ((65 * TIFFGetR(raster[i])) + (128 * TIFFGetG(raster[i])) + (25 * TIFFGetB(raster[i])) >> 8);
-        Cb(ycbcr, i, 3, 1)  = 128 + ((-38 * TIFFGetR(raster[i])) - (74 * TIFFGetG(raster[i])) + (112 * TIFFGetB(raster[i]))  >> 8);
-        Cr(ycbcr, i, 3, 2)  = 128 + ((112 * TIFFGetR(raster[i])) - (94 * TIFFGetG(raster[i])) - (18 * TIFFGetB(raster[i])) >> 8);
-    }
-
-    return ycbcr;
+// Times one subsampling mode of the 4:4:4 frame and writes it with the sampling and siting tags of the mode
+void measureSubsampling(subsampling_t subsampling, const uint32* raster, const image_t* image, char* tag){
+    struct timeval stop, start;
+    uint8* ycbcr = convert_rgb_to_ycbcr_v3(raster, image);
+    uint8* subsampled_ycbcr = allocateFrame(subsampled_frame_size(image, subsampling));
+    uint8* reference = allocateFrame(subsampled_frame_size(image, subsampling));
+    gettimeofday(&start, NULL);
+    subsample_ycbcr_simd_into(ycbcr, subsampled_ycbcr, image, subsampling);
+    gettimeofday(&stop, NULL);
+    uint64 delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
+    printf("\033[1;36m[%s]\033[0m Subsampling took \033[1;36m%lu\033[0m microseconds\n", tag, delta);
+    subsample_ycbcr_into(ycbcr, reference, image, subsampling);
+    printAccuracy(reference, subsampling_format(subsampling), subsampled_ycbcr, subsampling_format(subsampling), image);
+    write_tiff_image(subsampled_ycbcr, tag, image, subsampling);
+    free(subsampled_ycbcr);
+    free(ycbcr);
 }
 
 
-uint8* convert_rgb_to_ycbcr_v2(const uint32 *raster){
-
-    uint32 num_pixels = 640 * 480;
-    register uint16 tempY, tempCb, tempCr;
-    register uint32 tempPixel = raster[0];
-    register uint8 r = TIFFGetR(tempPixel);
-    register uint8 g = TIFFGetG(tempPixel);
-    register uint8 b = TIFFGetB(tempPixel);
-
-    tempY = 16 + ((65 * r) + (128 * g) + (25 * b) >> 8);
-    tempCb = 128 + ((-37 * r) - (74 * g) + (112 * b) >> 8);
-    tempCr = 128 + ((112 * r) - (94 * g) - (18 * b) >> 8);
-
-    uint8* ycbcr = malloc(num_pixels*3);
-    for (register uint32 pixel = 1; pixel < num_pixels; pixel++) {
-
-
-        Y(ycbcr, pixel, 3, 0) = tempY;
-        Cb(ycbcr, pixel, 3, 1) = tempCb;
-        Cr(ycbcr, pixel, 3, 2) = tempCr;
-
-
-
-        tempY = 16 + (((65 * r) + (128 * g) + (25 * b)) >> 8);
-        tempCb = 128 + (((-37 * r) - (74 * g) + (112 * b)) >> 8);
-        tempCr = 128 + (((112 * r) - (94 * g) - (18 * b)) >> 8);
-
-
-        tempPixel = raster[pixel];
-        r =  TIFFGetR(tempPixel);
-        g =  TIFFGetG(tempPixel);
-        b =  TIFFGetB(tempPixel);
-
-
-    }
-
-    Y(ycbcr, 0, 3, 1) = tempY;
-    Cb(ycbcr, 0, 3, 1) = tempCb;
-    Cr(ycbcr, 0, 3, 1) = tempCr;
-
-    return ycbcr;
+// Times a whole RGB -> 4:2:0 path, conversion and downsampling included
+void measureConversion420(uint8*(convert)(const uint32*, const image_t*), const uint32* raster, const image_t* image, char* tag){
+    struct timeval stop, start;
+    gettimeofday(&start, NULL);
+    uint8* downsampled_ycbcr = convert(raster, image);
+    gettimeofday(&stop, NULL);
+    uint64 delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
+    printf("\033[1;36m[%s]\033[0m RGB TO YCbCr 4:2:0 took \033[1;36m%lu\033[0m microseconds\n", tag, delta);
+    printAccuracy(reference420(raster, image), FRAME_YCBCR420, downsampled_ycbcr, FRAME_YCBCR420, image);
+    write_tiff_image(downsampled_ycbcr, tag, image, SUBSAMPLING_420);
+    free(downsampled_ycbcr);
 }
 
 
-uint8* convert_rgb_to_ycbcr_v2_5(const uint32 *raster){
-
-    uint32 num_pixels = 640 * 480;
-    uint8* ycbcr = calloc(num_pixels*3, 1);
-
-    for (int i = 0; i < num_pixels; i++) {
-        //YCC[0] = (0.257 * red) + (0.504 * green) + (0.098 * blue) + 16;
-        Y(ycbcr, i, 3,  0) = 16 + (((TIFFGetR(raster[i])<<6)+(TIFFGetR(raster[i])<<1)+(TIFFGetG(raster[i])<<7)+TIFFGetG(raster[i])+(TIFFGetB(raster[i])<<4)+(TIFFGetB(raster[i])<<3)+TIFFGetB(raster[i])>>8));
-        //YCC[1] = (-0.148 * red) - (0.291 * green) + (0.439 * blue) + 128;
-        Cb(ycbcr, i, 3, 1) = 128 + ((-((TIFFGetR(raster[i])<<5)+(TIFFGetR(raster[i])<<2)+(TIFFGetR(raster[i])<<1))-((TIFFGetG(raster[i])<<6)+(TIFFGetG(raster[i])<<3)+(TIFFGetG(raster[i])<<1))+(TIFFGetB(raster[i])<<7)-(TIFFGetB(raster[i])<<4))>>8);
-        //YCC[2] = (0.439 * red) - (0.369 * green) - (0.071 * blue) + 128;
-        Cb(ycbcr, i, 3, 2)  = 128 + (((TIFFGetR(raster[i])<<7)-(TIFFGetR(raster[i])<<4)-((TIFFGetG(raster[i])<<6)+(TIFFGetG(raster[i])<<5)-(TIFFGetG(raster[i])<<1))-((TIFFGetB(raster[i])<<4)+(TIFFGetB(raster[i])<<1)))>>8);
-    }
-
-    return ycbcr;
+// Times a planar 4:2:0 kernel into a caller-owned frame and writes it as raw .yuv
+void measurePlanar(void(convert)(const uint32*, uint8*, const image_t*), planar_layout_t layout, const uint32* raster, const image_t* image, char* tag){
+    struct timeval stop, start;
+    uint8* frame = allocateFrame(PLANAR_FRAME_SIZE(image));
+    gettimeofday(&start, NULL);
+    convert(raster, frame, image);
+    gettimeofday(&stop, NULL);
+    uint64 delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
+    printf("\033[1;36m[%s]\033[0m RGB TO YCbCr 4:2:0 took \033[1;36m%lu\033[0m microseconds\n", tag, delta);
+    printAccuracy(reference420(raster, image), FRAME_YCBCR420, frame, layout == LAYOUT_I420 ? FRAME_I420 : FRAME_NV12, image);
+    write_yuv_image(frame, tag, image, layout);
+    free(frame);
 }
 
 
-uint8* convert_rgb_to_ycbcr_v3(const uint32 *raster){
-    uint8* raster_8 = (uint8 *) raster;
-    uint32 num_pixels = 640 * 480;
-    uint8* ycbcr = calloc(num_pixels*3, 1);
-    uint8x16x3_t ycbcr_split; //result
-    uint16x8x2_t y_16;
-    uint16x8x2_t Cb_16;
-    uint16x8x2_t Cr_16;
-
-    uint8x8x2_t r;
-    uint8x8x2_t g;
-    uint8x8x2_t b;
-
-
-    //Load scalar values
-    uint8x8x3_t scalar_Y;
-    scalar_Y.val[0] = vdup_n_u8(65); //Load 16x1 8bit vector with 65 [65,65,65...]
-    scalar_Y.val[1]  = vdup_n_u8(129); //same for lines 287-300
-    scalar_Y.val[2]  = vdup_n_u8(25);
-
-    uint8x8x3_t scalar_Cb;
-    scalar_Cb.val[0] = vdup_n_u8(37);
-    scalar_Cb.val[1]  = vdup_n_u8(74);
-    scalar_Cb.val[2]  = vdup_n_u8(112);
-
-    uint8x8x2_t scalar_Cr;
-    scalar_Cr.val[0] = vdup_n_u8(94);
-    scalar_Cr.val[1]  = vdup_n_u8(18);
-
-    uint8x16_t offset = vdupq_n_u8(16);
-
-
-    //Load 64 bytes of interleaved ABGR pixel data into 4 vectors of R,G,B,A (16 values per vector)
-    uint8x16x4_t rgba = vld4q_u8(raster_8);
-
-    for (int i = 0; i < 19200; ++i) { //640x480x4 bytes / 64 bytes per iteration = 19200
-
-        r.val[0] = vget_low_u8(rgba.val[0]); //take the first 8 values of the r vector
-        r.val[1] = vget_high_u8(rgba.val[0]); //take the last 8 values of the r vector
-        g.val[0] = vget_low_u8(rgba.val[1]); //ditto
-        g.val[1] = vget_high_u8(rgba.val[1]);
-        b.val[0] = vget_low_u8(rgba.val[2]);
-        b.val[1] = vget_high_u8(rgba.val[2]);
-
-
-        // Multiply red pixel by Y scalar values
-        y_16.val[0] = vmull_u8(r.val[0], scalar_Y.val[0]);
-        y_16.val[1] = vmull_u8(r.val[1], scalar_Y.val[0]);
-
-        //Multiply green pixel by Y scalar values and add the multiplication with store value
-        y_16.val[0] = vmlal_u8(y_16.val[0], g.val[0], scalar_Y.val[1]);
-        y_16.val[1] = vmlal_u8(y_16.val[1], g.val[1], scalar_Y.val[1]);
-        //Multiply blue pixel by Y scalar values and add the multiplication with store value
-        y_16.val[0] = vmlal_u8(y_16.val[0], b.val[0], scalar_Y.val[2]);
-        y_16.val[1] = vmlal_u8(y_16.val[1], b.val[1], scalar_Y.val[2]);
-
-        //128 in fixed point
-        Cb_16.val[0] = vdupq_n_u16(32768);
-        Cb_16.val[1] = vdupq_n_u16(32768);
-
-        Cr_16.val[0] = vdupq_n_u16(32768);
-        Cr_16.val[1] = vdupq_n_u16(32768);
-
-
-        //Multiply red pixel by Cb scalar values and add the multiplication with store value
-        Cb_16.val[0] = vmlsl_u8(Cb_16.val[0], r.val[0], scalar_Cb.val[0]);
-        Cb_16.val[1] = vmlsl_u8(Cb_16.val[1], r.val[1], scalar_Cb.val[0]);
-        //Multiply green pixel by Cb scalar values and add the multiplication with store value
-        Cb_16.val[0] = vmlsl_u8(Cb_16.val[0], g.val[0], scalar_Cb.val[1]);
-        Cb_16.val[1] = vmlsl_u8(Cb_16.val[1], g.val[1], scalar_Cb.val[1]);
-        //Multiply blue pixel by Cb scalar values and add the multiplication with store value
-        Cb_16.val[0] = vmlal_u8(Cb_16.val[0], b.val[0], scalar_Cb.val[2]);
-        Cb_16.val[1] = vmlal_u8(Cb_16.val[1], b.val[1], scalar_Cb.val[2]);
-        //Multiply red pixel by the same scalar value, since they are the same
-        Cr_16.val[0] = vmlal_u8(Cr_16.val[0], r.val[0], scalar_Cb.val[2]);
-        Cr_16.val[1] = vmlal_u8(Cr_16.val[1], r.val[1], scalar_Cb.val[2]);
-        //Multiply green pixel by Cr scalar values and add the multiplication with store value
-        Cr_16.val[0] = vmlsl_u8(Cr_16.val[0], g.val[0], scalar_Cr.val[0]);
-        Cr_16.val[1] = vmlsl_u8(Cr_16.val[1], g.val[1], scalar_Cr.val[0]);
-        //Multiply blue pixel by Cr scalar values and add the multiplication with store value
-        Cr_16.val[0] = vmlsl_u8(Cr_16.val[0], b.val[0], scalar_Cr.val[1]);
-        Cr_16.val[1] = vmlsl_u8(Cr_16.val[1], b.val[1], scalar_Cr.val[1]);
-
-        //shift both 8x8 16-bit vectors by 8 to convert to 8-bit, combine two 8x8 8-bit vectors into 1 8x16, and add 16
-        ycbcr_split.val[0] = vaddq_u8(vcombine_u8(vqshrn_n_u16(y_16.val[0], 8), vqshrn_n_u16(y_16.val[1], 8)), offset);
-
-        //shift both 8x8 16-bit vectors by 8 to convert to 8-bit, combine two 8x8 8-bit vectors into 1 8x16
-        ycbcr_split.val[1] = vcombine_u8(vqshrn_n_u16(Cb_16.val[0], 8), vqshrn_n_u16(Cb_16.val[1], 8));
-        ycbcr_split.val[2] = vcombine_u8(vqshrn_n_u16(Cr_16.val[0], 8), vqshrn_n_u16(Cr_16.val[1], 8));
-
-        //interveave the three seperate y, cb, cr vectors into an array of YCbCrYCbCr.. etc
-        vst3q_u8(ycbcr + (48*i), ycbcr_split); //move pointer 16 (values) * 3 (samples)
-        raster_8 +=64; // load next 64 bytes;
-        rgba = vld4q_u8(raster_8);
-    }
-
-    return ycbcr;
+// Times the inverse 4:2:0 -> RGB conversion of the fused 4:2:0 frame and writes an RGBA preview
+void measureInverse(void(convert)(const uint8*, uint32*, const image_t*, upsample_t), upsample_t filter, const uint32* raster, const image_t* image, char* tag){
+    struct timeval stop, start;
+    uint8* downsampled_ycbcr = convert_rgb_to_ycbcr420_simd(raster, image);
+    uint32* rgb = allocateFrame((size_t) image->stride * image->height * sizeof(uint32));
+    gettimeofday(&start, NULL);
+    convert(downsampled_ycbcr, rgb, image, filter);
+    gettimeofday(&stop, NULL);
+    uint64 delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
+    printf("\033[1;36m[%s]\033[0m YCbCr 4:2:0 TO RGB took \033[1;36m%lu\033[0m microseconds\n", tag, delta);
+    uint32* reference = allocateFrame((size_t) image->stride * image->height * sizeof(uint32));
+    convert_ycbcr420_to_rgb_into(downsampled_ycbcr, reference, image, filter);
+    printAccuracy((uint8*) reference, FRAME_RGBA, rgb, FRAME_RGBA, image);
+    write_tiff_rgb_image(rgb, tag, image);
+    free(rgb);
+    free(downsampled_ycbcr);
 }
 
 
-void* simd_worker(void* args){
-
-    worker_data_t* workerData = (worker_data_t*) args;
-
-    uint8* raster_8 = (uint8 *) workerData->segment;
-    uint8x16x3_t ycbcr_split;
-    uint16x8x2_t y_16;
-    uint16x8x2_t Cb_16;
-    uint16x8x2_t Cr_16;
-
-    uint8x8x2_t r;
-    uint8x8x2_t g;
-    uint8x8x2_t b;
-
-    uint8x8x3_t scalar_Y;
-    scalar_Y.val[0] = vdup_n_u8(65);
-    scalar_Y.val[1]  = vdup_n_u8(129);
-    scalar_Y.val[2]  = vdup_n_u8(25);
-
-    uint8x8x3_t scalar_Cb;
-    scalar_Cb.val[0] = vdup_n_u8(37);
-    scalar_Cb.val[1]  = vdup_n_u8(74);
-    scalar_Cb.val[2]  = vdup_n_u8(112);
-
-    uint8x8x2_t scalar_Cr;
-    scalar_Cr.val[0] = vdup_n_u8(94);
-    scalar_Cr.val[1]  = vdup_n_u8(18);
-
-    uint8x16_t offset = vdupq_n_u8(16);
-
-    uint8x16x4_t rgba = vld4q_u8(raster_8);
-
-    for (int i = 0; i < 4800; ++i) {
-
-        r.val[0] = vget_low_u8(rgba.val[0]);
-        r.val[1] = vget_high_u8(rgba.val[0]);
-        g.val[0] = vget_low_u8(rgba.val[1]);
-        g.val[1] = vget_high_u8(rgba.val[1]);
-        b.val[0] = vget_low_u8(rgba.val[2]);
-        b.val[1] = vget_high_u8(rgba.val[2]);
-
-        y_16.val[0] = vmull_u8(r.val[0], scalar_Y.val[0]);
-        y_16.val[1] = vmull_u8(r.val[1], scalar_Y.val[0]);
-        y_16.val[0] = vmlal_u8(y_16.val[0], g.val[0], scalar_Y.val[1]);
-        y_16.val[1] = vmlal_u8(y_16.val[1], g.val[1], scalar_Y.val[1]);
-        y_16.val[0] = vmlal_u8(y_16.val[0], b.val[0], scalar_Y.val[2]);
-        y_16.val[1] = vmlal_u8(y_16.val[1], b.val[1], scalar_Y.val[2]);
-
-
-        Cb_16.val[0] = vdupq_n_u16(32768);
-        Cb_16.val[1] = vdupq_n_u16(32768);
-
-        Cr_16.val[0] = vdupq_n_u16(32768);
-        Cr_16.val[1] = vdupq_n_u16(32768);
-
-        Cb_16.val[0] = vmlsl_u8(Cb_16.val[0], r.val[0], scalar_Cb.val[0]);
-        Cb_16.val[1] = vmlsl_u8(Cb_16.val[1], r.val[1], scalar_Cb.val[0]);
-        Cb_16.val[0] = vmlsl_u8(Cb_16.val[0], g.val[0], scalar_Cb.val[1]);
-        Cb_16.val[1] = vmlsl_u8(Cb_16.val[1], g.val[1], scalar_Cb.val[1]);
-        Cb_16.val[0] = vmlal_u8(Cb_16.val[0], b.val[0], scalar_Cb.val[2]);
-        Cb_16.val[1] = vmlal_u8(Cb_16.val[1], b.val[1], scalar_Cb.val[2]);
-        Cr_16.val[0] = vmlal_u8(Cr_16.val[0], r.val[0], scalar_Cb.val[2]);
-        Cr_16.val[1] = vmlal_u8(Cr_16.val[1], r.val[1], scalar_Cb.val[2]);
-        Cr_16.val[0] = vmlsl_u8(Cr_16.val[0], g.val[0], scalar_Cr.val[0]);
-        Cr_16.val[1] = vmlsl_u8(Cr_16.val[1], g.val[1], scalar_Cr.val[0]);
-        Cr_16.val[0] = vmlsl_u8(Cr_16.val[0], b.val[0], scalar_Cr.val[1]);
-        Cr_16.val[1] = vmlsl_u8(Cr_16.val[1], b.val[1], scalar_Cr.val[1]);
-
+// Steady-state 4:2:0 conversion into recycled frames, reports the page faults taken per frame
+void measureFramePool(void(convert)(const uint32*, uint8*, const image_t*), const uint32* raster, const image_t* image, char* tag){
+    struct timeval stop, start;
+    struct rusage usage_start, usage_stop;
+    frame_pool_t* pool = frame_pool_create(DOWNSAMPLED_FRAME_SIZE(image), 2);
 
-        ycbcr_split.val[0] = vaddq_u8(vcombine_u8(vqshrn_n_u16(y_16.val[0], 8), vqshrn_n_u16(y_16.val[1], 8)), offset);
-        ycbcr_split.val[1] = vcombine_u8(vqshrn_n_u16(Cb_16.val[0], 8), vqshrn_n_u16(Cb_16.val[1], 8));
-        ycbcr_split.val[2] = vcombine_u8(vqshrn_n_u16(Cr_16.val[0], 8), vqshrn_n_u16(Cr_16.val[1], 8));
-        vst3q_u8(workerData->conv_segment, ycbcr_split);
-        workerData->conv_segment+=48;
-        raster_8 +=64;
-        rgba = vld4q_u8(raster_8);
+    getrusage(RUSAGE_SELF, &usage_start);
+    gettimeofday(&start, NULL);
+    for (int frame = 0; frame < SCALING_FRAMES; ++frame) {
+        uint8* downsampled_ycbcr = frame_pool_get(pool);
+        convert(raster, downsampled_ycbcr, image);
+        frame_pool_put(pool, downsampled_ycbcr);
     }
-    return NULL;
+    gettimeofday(&stop, NULL);
+    getrusage(RUSAGE_SELF, &usage_stop);
+    uint64 delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
+    printf("\033[1;36m[%s]\033[0m RGB TO YCbCr 4:2:0 took \033[1;36m%lu\033[0m microseconds per frame, \033[1;36m%.1f\033[0m page faults per frame\n",
+           tag, delta / SCALING_FRAMES, (double) (usage_stop.ru_minflt - usage_start.ru_minflt + usage_stop.ru_majflt - usage_start.ru_majflt) / SCALING_FRAMES);
+    frame_pool_destroy(pool);
 }
 
 
-uint8* simd_asm(const uint32 *raster){
+// Times the streaming pipeline end to end, decoding and writing included
+void measureStreaming(char* filename, uint32 ring_size, char* tag){
+    struct timeval stop, start;
+    gettimeofday(&start, NULL);
+    size_t working_set = convert_tiff_streaming(filename, tag, ring_size);
+    gettimeofday(&stop, NULL);
+    uint64 delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
+    printf("\033[1;36m[%s]\033[0m Read, RGB TO YCbCr 4:2:0 and write took \033[1;36m%lu\033[0m microseconds with \033[1;36m%zu\033[0m KiB of strip buffers\n",
+           tag, delta, working_set / 1024);
 }
 
 
-uint8* convert_rgb_to_ycbcr_v4(const uint32 *raster) {
-
-    int thread_offset = 76800;
-    pthread_t threads[4];
-    pthread_attr_t attr;
-    cpu_set_t cpus;
-    pthread_attr_init(&attr);
-
-    uint8 *ycbcr = malloc(921600);
-    worker_data_t *workerData = malloc(sizeof(worker_data_t) * 4);
+// Microseconds per frame of convert into the same output frame, averaged over SCALING_FRAMES frames after one warm-up frame
+static double frameLatency(void (*convert)(const uint32*, uint8*, const image_t*), const uint32* raster, uint8* frame,
+                           const image_t* image){
+    struct timeval stop, start;
+    convert(raster, frame, image);
+    gettimeofday(&start, NULL);
+    for (int i = 0; i < SCALING_FRAMES; ++i) {
+        convert(raster, frame, image);
+    }
+    gettimeofday(&stop, NULL);
+    return (double) ((stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec) / SCALING_FRAMES;
+}
 
-    for (int id = 0; id < 4; ++id) {
 
-        (workerData + id)->segment = (uint8 *) (raster + (thread_offset * id));
-        (workerData + id)->conv_segment = (ycbcr + (230400 * id));
+// Per-frame latency of the multithreaded kernels with 1, 2, 4, ... up to every CPU of cpus
+void measureScaling(const uint32* raster, const image_t* image, const cpu_set_t* cpus){
+    int max_threads = CPU_COUNT(cpus);
+    double base_444 = 0, base_420 = 0;
+    thread_pool_t* previous = thread_pool_default();
+    // allocated once, so neither the page faults of a new frame nor free() are timed
+    uint8* frame = frame_alloc(YCBCR_FRAME_SIZE(image));
 
-        CPU_ZERO(&cpus);
-        CPU_SET(id, &cpus);
-        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
-        pthread_create(&threads[id], NULL, simd_worker, (void *) (workerData + id));
+    if (frame == NULL) {
+        printf("[-] \033[0;31mCould not allocate the output frame\033[0m\n");
+        return;
     }
-    for (int id = 0; id < 4; ++id) {
-        pthread_join(threads[id], NULL);
+    memset(frame, 0, YCBCR_FRAME_SIZE(image));
+
+    for (int n_threads = 1; n_threads <= max_threads; n_threads = (n_threads * 2 > max_threads && n_threads < max_threads) ? max_threads : n_threads * 2) {
+        thread_pool_t* pool = thread_pool_create(n_threads, cpus);
+        if (pool == NULL) {
+            printf("[-] \033[0;31mCould not create a pool of %d threads\033[0m\n", n_threads);
+            break;
+        }
+        thread_pool_set_default(pool);
+        double latency_444 = frameLatency(convert_rgb_to_ycbcr_v4_into, raster, frame, image);
+        double latency_420 = frameLatency(convert_rgb_to_ycbcr420_v4_into, raster, frame, image);
+        if (n_threads == 1) {
+            base_444 = latency_444;
+            base_420 = latency_420;
+        }
+        printf("\033[1;36m[%2d threads]\033[0m 4:4:4 \033[1;36m%.1f\033[0m us/frame (%.2fx), 4:2:0 \033[1;36m%.1f\033[0m us/frame (%.2fx)\n",
+               thread_pool_size(pool), latency_444, base_444 / latency_444, latency_420, base_420 / latency_420);
+        thread_pool_destroy(pool);
     }
 
-    return ycbcr;
+    thread_pool_set_default(previous);
+    free(frame);
 }
 
 
-void measureConversion(uint8*(convert)(const uint32*), uint32* image, char* tag){
-    struct timeval stop, start;
-    gettimeofday(&start, NULL);
-    uint8* ycbcr = convert(image);
-    gettimeofday(&stop, NULL);
-    uint64 delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
-    printf("\033[1;36m[%s]\033[0m RGB TO YCbCr Conversion took \033[1;36m%lu\033[0m microseconds\n", tag, delta);
-    write_tiff_image(ycbcr, tag, 640, 480, 1, 1);
+// Parses the name of a TIFF compression and makes it the one of every output file
+static bool parse_compression(const char* name){
+    if (strcmp(name, "none") == 0) {
+        set_tiff_compression(COMPRESSION_NONE);
+    } else if (strcmp(name, "lzw") == 0) {
+        set_tiff_compression(COMPRESSION_LZW);
+    } else if (strcmp(name, "deflate") == 0) {
+        set_tiff_compression(COMPRESSION_ADOBE_DEFLATE);
+    } else {
+        return false;
+    }
+    return true;
 }
 
 
-void measureDownsampling(uint8*(convert)(const uint32*), uint8*(downsample)(const uint8*), uint32* image, char* tag){
+// Times writing the same 4:4:4 and 4:2:0 frames uncompressed, LZW and Deflate compressed
+void measureWriting(const uint32* raster, const image_t* image){
+    static const char* names[] = {"none", "lzw", "deflate"};
+    uint8* ycbcr = convert_rgb_to_ycbcr_v3(raster, image);
+    uint8* downsampled_ycbcr = convert_rgb_to_ycbcr420_simd(raster, image);
     struct timeval stop, start;
-    uint8* ycbcr = convert(image);
-    gettimeofday(&start, NULL);
-    uint8* downsampled_ycbcr = downsample(ycbcr);
-    gettimeofday(&stop, NULL);
-    uint64 delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
-    printf("\033[1;36m[%s]\033[0m Downsampling took \033[1;36m%lu\033[0m microseconds\n", tag, delta);
-    write_tiff_image(downsampled_ycbcr, tag, 640, 480, 2, 2);
+    char tag[64];
+
+    for (int i = 0; i < 3; ++i) {
+        parse_compression(names[i]);
+
+        snprintf(tag, sizeof(tag), "Write 4:4:4 %s", names[i]);
+        gettimeofday(&start, NULL);
+        write_tiff_image(ycbcr, tag, image, SUBSAMPLING_444);
+        gettimeofday(&stop, NULL);
+        uint64 delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
+        printf("\033[1;36m[%s]\033[0m Writing took \033[1;36m%lu\033[0m microseconds\n", tag, delta);
+
+        snprintf(tag, sizeof(tag), "Write 4:2:0 %s", names[i]);
+        gettimeofday(&start, NULL);
+        write_tiff_image(downsampled_ycbcr, tag, image, SUBSAMPLING_420);
+        gettimeofday(&stop, NULL);
+        delta = (stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec;
+        printf("\033[1;36m[%s]\033[0m Writing took \033[1;36m%lu\033[0m microseconds\n", tag, delta);
+    }
 
+    free(downsampled_ycbcr);
+    free(ycbcr);
 }
 
 
 int main(int argc, char* argv[]) {
 
-    if (argc < 3){
+    cpu_set_t cpus;
+    color_space_t space = color_space;
+    bool cpus_set = false;
+    bool batch = false;
+    subsampling_t subsampling = SUBSAMPLING_420;
+    const char* wisdom_file = NULL;
+    image_t raw_image = {0, 0, 0, 0};
+    pixel_format_t raw_format = PIXEL_RGB24;
+    planar_layout_t raw_layout = LAYOUT_I420;
+    int n_workers = 0;
+    int option;
+
+    // -c restricts the worker pool to a CPU list (e.g. 0-3,8), -z compresses the output files,
+    // -b converts every input frame into the output directory with -j workers instead of benchmarking one,
+    // -y picks the color matrix and range of the kernels (bt601, bt709, bt2020, each with -full),
+    // -s the chroma subsampling of the batch output (420, 422, 411, 444 or 420-cosited),
+    // -w the wisdom file the batch takes its kernels and worker count from, tuning them on the first run,
+    // -p profiles the stages of the batch workers and the streaming pipeline into a trace file,
+    // -r WxH converts raw frames of -f rgb24, rgba, bgra or rgb48le from stdin to -l i420 or nv12 on stdout,
+    // -L turns on the large-frame mode for 4K and 8K: huge pages, prefetching and non-temporal output stores
+    while ((option = getopt(argc, argv, "c:z:bj:y:s:w:p:r:f:l:L")) != -1) {
+        switch (option) {
+            case 'L':
+                large_frames = true;
+                break;
+            case 'b':
+                batch = true;
+                break;
+            case 'j':
+                n_workers = atoi(optarg);
+                break;
+            case 'c':
+                if (!parse_cpu_list(optarg, &cpus)) {
+                    printf("[-] \033[1;31mInvalid CPU list %s\033[0m\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                cpus_set = true;
+                break;
+            case 'z':
+                if (!parse_compression(optarg)) {
+                    printf("[-] \033[1;31mUnknown compression %s, use none, lzw or deflate\033[0m\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'y':
+                if (!parse_color_space(optarg, &space)) {
+                    printf("[-] \033[1;31mUnknown color space %s, use bt601, bt709 or bt2020 with an optional -full\033[0m\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 's':
+                if (!parse_subsampling(optarg, &subsampling)) {
+                    printf("[-] \033[1;31mUnknown subsampling %s, use 420, 422, 411, 444 or 420-cosited\033[0m\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'w':
+                wisdom_file = optarg;
+                break;
+            case 'r':
+                if (sscanf(optarg, "%ux%u", &raw_image.width, &raw_image.height) != 2 || raw_image.width == 0 || raw_image.height == 0) {
+                    printf("[-] \033[1;31mInvalid frame size %s, use WIDTHxHEIGHT\033[0m\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'f':
+                if (!parse_pixel_format(optarg, &raw_format)) {
+                    printf("[-] \033[1;31mUnknown pixel format %s, use rgb24, rgba, bgra or rgb48le\033[0m\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'l':
+                if (strcmp(optarg, "i420") != 0 && strcmp(optarg, "nv12") != 0) {
+                    printf("[-] \033[1;31mUnknown layout %s, use i420 or nv12\033[0m\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                raw_layout = strcmp(optarg, "nv12") == 0 ? LAYOUT_NV12 : LAYOUT_I420;
+                break;
+            case 'p':
+                if (!profile_open(optarg)) {
+                    printf("[-] \033[1;31mCould not write the profile to %s\033[0m\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            default:
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (raw_image.width > 0) {
+        // stdout carries the frames, the messages go to stderr
+        int output_fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        if (!cpus_set && sched_getaffinity(0, sizeof(cpu_set_t), &cpus) != 0) {
+            CPU_ZERO(&cpus);
+            CPU_SET(0, &cpus);
+        }
+        select_kernels();
+        select_color_space(&space);
+        printf("[o] Using \033[1;36m%s\033[0m kernels, \033[1;36m%s\033[0m\n", kernels->name, color_space_name(&color_space));
+        thread_pool_set_default(thread_pool_create(0, &cpus));
+        convert_raw_pipe(STDIN_FILENO, output_fd, &raw_image, raw_format, raw_layout);
+        thread_pool_destroy(thread_pool_default());
+        profile_close();
+        close(output_fd);
+        return 0;
+    }
+    if (argc - optind < 2){
         printf("[-] \033[1;31mProvide a file name and output location!\033[0m\n");
+        printf("usage: %s [-c cpus] [-z none|lzw|deflate] [-y color space] [-p trace] [-L] input output\n"
+               "       %s -b [-j workers] [-c cpus] [-z none|lzw|deflate] [-y color space] [-s subsampling] [-w wisdom] [-p trace] [-L] output_dir input|directory|'glob'|@list...\n"
+               "       %s -r WxH [-f rgb24|rgba|bgra|rgb48le] [-l i420|nv12] [-c cpus] [-y color space] [-p trace] [-L] < frames > yuv\n",
+               argv[0], argv[0], argv[0]);
         exit(EXIT_FAILURE);
     }
+    argv += optind - 1;
+
+    if (!cpus_set && sched_getaffinity(0, sizeof(cpu_set_t), &cpus) != 0) {
+        CPU_ZERO(&cpus);
+        CPU_SET(0, &cpus);
+    }
+
+    select_kernels();
+    select_color_space(&space);
+    printf("[o] Using \033[1;36m%s\033[0m kernels, \033[1;36m%s\033[0m\n", kernels->name, color_space_name(&color_space));
+
+    if (batch) {
+        // the parallelism is across frames, the pool of each frame is just the worker itself
+        thread_pool_set_default(thread_pool_create(1, NULL));
+        uint32 failed = convert_tiff_batch(argv + 2, argc - optind - 1, argv[1], n_workers, &cpus, subsampling, wisdom_file);
+        thread_pool_destroy(thread_pool_default());
+        profile_close();
+        return failed ? EXIT_FAILURE : 0;
+    }
+    thread_pool_set_default(thread_pool_create(0, &cpus));
+
+    image_t image;
+    mapped_file_t mapping = {NULL, 0};
+    uint32* read_image = NULL;
+    // uncompressed frames are converted straight from the page cache, anything else is decoded
+    const uint32* rgb_image = map_tiff_raster(argv[1], &image, &mapping);
+    if (rgb_image != NULL) {
+        printf("[o] Mapped Image (%ux%u), the kernels read the file in place\n", image.width, image.height);
+    } else {
+        rgb_image = read_image = read_tiff_image(argv[1], &image);
+    }
+    measureConversion(convert_rgb_to_ycbcr, rgb_image, &image, "Unoptimized");
+    if (fixedPointColorSpace()) {
+        measureConversion(convert_rgb_to_ycbcr_v1, rgb_image, &image, "Fixed-Point Arithmetic");
+        measureConversion(convert_rgb_to_ycbcr_v2, rgb_image, &image, "Fixed-Point Arithmetic with Software Pipelining");
+        measureConversion(convert_rgb_to_ycbcr_v2_5, rgb_image, &image, "Shift Only");
+    } else {
+        printf("[o] Skipping the BT.601 studio-range fixed-point kernels for %s\n", color_space_name(&color_space));
+    }
+    measureConversion(convert_rgb_to_ycbcr_lut, rgb_image, &image, "Lookup Tables");
+    measureConversion(convert_rgb_to_ycbcr_v3, rgb_image, &image, "SIMD");
+    measureConversion(convert_rgb_to_ycbcr_v4, rgb_image, &image, "Multithreaded SIMD");
+
+    image_t image48;
+    mapped_file_t mapping48 = {NULL, 0};
+    uint16* read_image48 = NULL;
+    const uint16* rgb48_image = map_tiff_rgb48(argv[1], &image48, &mapping48);
+    if (rgb48_image != NULL) {
+        printf("[o] Mapped 48-bit Image (%ux%u), the kernels read the file in place\n", image48.width, image48.height);
+    } else {
+        rgb48_image = read_image48 = read_tiff_image_rgb48(argv[1], &image48);
+    }
+    if (rgb48_image != NULL){
+        if (fixedPointColorSpace()) {
+            measureConversion48(convert_rgb48_to_ycbcr_v1, rgb48_image, &image48, "48-bit Fixed-Point Arithmetic");
+        }
+        measureConversion48(convert_rgb48_to_ycbcr_lut, rgb48_image, &image48, "48-bit Lookup Tables");
+        measureConversion48(convert_rgb48_to_ycbcr_simd, rgb48_image, &image48, "48-bit SIMD");
+        measureConversion48(convert_rgb48_to_ycbcr_precise, rgb48_image, &image48, "48-bit Full Precision SIMD");
+        unmap_tiff(&mapping48);
+        free(read_image48);
+    }
 
-    uint32* rgb_image = read_tiff_image(argv[1]);
-    measureConversion(convert_rgb_to_ycbcr, rgb_image, "Unoptimized");
-    measureConversion(convert_rgb_to_ycbcr_v1, rgb_image, "Fixed-Point Arithmetic");
-    measureConversion(convert_rgb_to_ycbcr_v2, rgb_image, "Fixed-Point Arithmetic with Software Pipelining");
-    measureConversion(convert_rgb_to_ycbcr_v2_5, rgb_image, "Shift Only");
-    measureConversion(convert_rgb_to_ycbcr_v3, rgb_image, "SIMD");
-
-    measureDownsampling(convert_rgb_to_ycbcr_v1, downsample_ycbcr, rgb_image, "Downsample Unoptimized");
-    measureDownsampling(convert_rgb_to_ycbcr_v1, downsample_ycbcr_v1, rgb_image, "Downsample Naive with Bit Shift");
-    measureDownsampling(convert_rgb_to_ycbcr_v1, downsample_ycbcr_v2, rgb_image, "Downsample Fill-Backfill");
-    measureDownsampling(convert_rgb_to_ycbcr_v1, downsample_ycbcr_simd, rgb_image, "Downsample SIMD");
+    measureDownsampling(convert_rgb_to_ycbcr_v3, downsample_ycbcr, rgb_image, &image, "Downsample Unoptimized");
+    measureDownsampling(convert_rgb_to_ycbcr_v3, downsample_ycbcr_v1, rgb_image, &image, "Downsample Naive with Bit Shift");
+    measureDownsampling(convert_rgb_to_ycbcr_v3, downsample_ycbcr_v2, rgb_image, &image, "Downsample Fill-Backfill");
+    measureDownsampling(convert_rgb_to_ycbcr_v3, downsample_ycbcr_simd, rgb_image, &image, "Downsample SIMD");
+    measureDownsampling(convert_rgb_to_ycbcr_v3, downsample_ycbcr_v4, rgb_image, &image, "Downsample Multithreaded SIMD");
+    measureSubsampling(SUBSAMPLING_422, rgb_image, &image, "Subsample SIMD 4:2:2");
+    measureSubsampling(SUBSAMPLING_411, rgb_image, &image, "Subsample SIMD 4:1:1");
+    measureSubsampling(SUBSAMPLING_444, rgb_image, &image, "Subsample 4:4:4 Pass-Through");
+    measureSubsampling(SUBSAMPLING_420_COSITED, rgb_image, &image, "Subsample SIMD Co-Sited 4:2:0");
+
+    measureConversion420(convert_rgb_to_ycbcr420_two_stage, rgb_image, &image, "Two-Stage SIMD 4:2:0");
+    measureConversion420(convert_rgb_to_ycbcr420_simd, rgb_image, &image, "Fused SIMD 4:2:0");
+    measureConversion420(convert_rgb_to_ycbcr420_v4, rgb_image, &image, "Multithreaded Fused SIMD 4:2:0");
+
+    measurePlanar(convert_rgb_to_i420_simd_into, LAYOUT_I420, rgb_image, &image, "Fused SIMD I420");
+    measurePlanar(convert_rgb_to_nv12_simd_into, LAYOUT_NV12, rgb_image, &image, "Fused SIMD NV12");
+    measurePlanar(convert_rgb_to_i420_v4_into, LAYOUT_I420, rgb_image, &image, "Multithreaded Fused SIMD I420");
+    measurePlanar(convert_rgb_to_nv12_v4_into, LAYOUT_NV12, rgb_image, &image, "Multithreaded Fused SIMD NV12");
+
+    measureInverse(convert_ycbcr420_to_rgb_simd_into, UPSAMPLE_NEAREST, rgb_image, &image, "SIMD 4:2:0 to RGB Nearest");
+    measureInverse(convert_ycbcr420_to_rgb_simd_into, UPSAMPLE_BILINEAR, rgb_image, &image, "SIMD 4:2:0 to RGB Bilinear");
+    measureInverse(convert_ycbcr420_to_rgb_v4_into, UPSAMPLE_NEAREST, rgb_image, &image, "Multithreaded SIMD 4:2:0 to RGB Nearest");
+    measureInverse(convert_ycbcr420_to_rgb_v4_into, UPSAMPLE_BILINEAR, rgb_image, &image, "Multithreaded SIMD 4:2:0 to RGB Bilinear");
+
+    measureFramePool(convert_rgb_to_ycbcr420_simd_into, rgb_image, &image, "Fused SIMD 4:2:0 Frame Pool");
+    measureFramePool(convert_rgb_to_ycbcr420_v4_into, rgb_image, &image, "Multithreaded Fused SIMD 4:2:0 Frame Pool");
+    measureStreaming(argv[1], 4, "Streaming 4:2:0");
+    measureWriting(rgb_image, &image);
+
+    printf("[o] Scaling over \033[1;36m%d\033[0m CPUs\n", CPU_COUNT(&cpus));
+    measureScaling(rgb_image, &image, &cpus);
+    thread_pool_destroy(thread_pool_default());
+    profile_close();
+    unmap_tiff(&mapping);
+    free(read_image);
 
     return 0;
 }
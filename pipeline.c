@@ -0,0 +1,288 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "conversion.h"
+#include "frame_pool.h"
+#include "profile.h"
+
+/**
+ * Streaming RGB -> YCbCr 4:2:0 conversion. The image is cut into chunks that go through a ring of
+ * reusable slots, and every stage (decode, conversion, downsampling, write) runs on its own thread. A
+ * slot moves to the next stage as soon as the previous one is done with it, so while chunk n is written
+ * chunk n+1 is downsampled, n+2 converted and n+3 decoded. Memory is bounded by the ring.
+ *
+ * 8-bit RGB and RGBA files are decoded a scanline at a time into chunks of about CHUNK_SIZE bytes, however
+ * their strips are laid out, so a frame stored as one compressed strip streams too. Anything else goes
+ * through TIFFReadRGBAStrip, which only decodes whole strips, and its chunks are strips.
+ */
+
+// Raster bytes per chunk of the files decoded a scanline at a time
+#define CHUNK_SIZE (256 * 1024)
+
+// same order as the profile_stage_t of their profiles
+enum { STAGE_READ, STAGE_CONVERT, STAGE_DOWNSAMPLE, STAGE_WRITE, N_STAGES };
+
+typedef struct strip_slot{
+    uint32* raster;
+    uint8* ycbcr;
+    uint8* downsampled_ycbcr;
+    uint32 first_row;
+    uint32 rows;
+    uint32 chunk;               // chunk the slot holds or is waiting for
+    int stage;                  // next stage to run on the slot
+} strip_slot_t;
+
+typedef struct pipeline{
+    const char* input_filename;
+    TIFF* input;
+    TIFF* output;
+    image_t image;
+    uint32 rows_per_strip;
+    uint16 samples_per_pixel;
+    bool associated_alpha;      // the 4th sample is kept as it is, without one TIFFReadRGBAStrip makes it opaque
+    uint8* scanline;            // of the read stage, NULL when the file is read in strips
+    uint32 chunk_rows;
+    uint32 n_chunks;
+    strip_slot_t* slots;
+    uint32 n_slots;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} pipeline_t;
+
+typedef struct stage{
+    pipeline_t* pipeline;
+    int id;
+    void (*run)(pipeline_t* pipeline, strip_slot_t* slot);
+} stage_t;
+
+
+// Decodes the rows of the slot one after the other into ABGR pixels, as TIFFReadRGBAStrip would
+static void read_scanlines(pipeline_t* pipeline, strip_slot_t* slot){
+    uint32 width = pipeline->image.width;
+    uint16 samples = pipeline->samples_per_pixel;
+
+    for (uint32 row = 0; row < slot->rows; ++row) {
+        uint8* pixels = (uint8*) (slot->raster + (size_t) row * width);
+
+        if (TIFFReadScanline(pipeline->input, pipeline->scanline, slot->first_row + row, 0) < 0) {
+            printf("[-] \033[0;31mReading row %u failed!\033[0m\n", slot->first_row + row);
+            exit(EXIT_FAILURE);
+        }
+        for (uint32 col = 0; col < width; ++col) {
+            const uint8* sample = pipeline->scanline + (size_t) col * samples;
+            pixels[col * 4] = sample[0];
+            pixels[col * 4 + 1] = sample[1];
+            pixels[col * 4 + 2] = sample[2];
+            pixels[col * 4 + 3] = pipeline->associated_alpha ? sample[3] : 255;
+        }
+    }
+}
+
+
+static void read_chunk(pipeline_t* pipeline, strip_slot_t* slot){
+    uint32 width = pipeline->image.width;
+
+    slot->first_row = slot->chunk * pipeline->chunk_rows;
+    slot->rows = (slot->first_row + pipeline->chunk_rows > pipeline->image.height) ? pipeline->image.height - slot->first_row : pipeline->chunk_rows;
+    if (pipeline->scanline != NULL) {
+        read_scanlines(pipeline, slot);
+        return;
+    }
+
+    uint32* row_buffer = malloc(width * sizeof(uint32));
+    if (row_buffer == NULL) {
+        printf("[-] \033[0;31mCould not allocate a row buffer\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32 row = 0; row < slot->rows; row+=pipeline->rows_per_strip) {
+        uint32* strip = slot->raster + (size_t) row * width;
+        uint32 strip_rows = (row + pipeline->rows_per_strip > slot->rows) ? slot->rows - row : pipeline->rows_per_strip;
+
+        if (!TIFFReadRGBAStrip(pipeline->input, slot->first_row + row, strip)){
+            printf("[-] \033[0;31mReading strip at row %u failed!\033[0m\n", slot->first_row + row);
+            exit(EXIT_FAILURE);
+        }
+        // strips come out bottom-up, flip them to the top-left order of read_tiff_image
+        for (uint32 top = 0, bottom = strip_rows - 1; top < bottom; ++top, --bottom) {
+            memcpy(row_buffer, strip + (size_t) top * width, width * sizeof(uint32));
+            memcpy(strip + (size_t) top * width, strip + (size_t) bottom * width, width * sizeof(uint32));
+            memcpy(strip + (size_t) bottom * width, row_buffer, width * sizeof(uint32));
+        }
+    }
+
+    free(row_buffer);
+}
+
+
+static void convert_chunk(pipeline_t* pipeline, strip_slot_t* slot){
+    kernels->convert(slot->raster, slot->ycbcr, &pipeline->image, slot->rows);
+}
+
+
+static void downsample_chunk(pipeline_t* pipeline, strip_slot_t* slot){
+    kernels->downsample(slot->ycbcr, slot->downsampled_ycbcr, &pipeline->image, slot->rows);
+}
+
+
+static void write_chunk(pipeline_t* pipeline, strip_slot_t* slot){
+    write_tiff_strips(pipeline->output, slot->downsampled_ycbcr, &pipeline->image, slot->first_row, slot->rows, SUBSAMPLING_420);
+}
+
+
+// Runs one stage over every chunk in order, waiting for the slot of each chunk to reach it
+static void* stage_worker(void* args){
+    stage_t* stage = (stage_t*) args;
+    pipeline_t* pipeline = stage->pipeline;
+    char name[32];
+
+    snprintf(name, sizeof(name), "stream %s", profile_stage_name((profile_stage_t) stage->id));
+    profiler_t* profiler = profiler_create(name);
+
+    for (uint32 chunk = 0; chunk < pipeline->n_chunks; ++chunk) {
+        strip_slot_t* slot = &pipeline->slots[chunk % pipeline->n_slots];
+
+        pthread_mutex_lock(&pipeline->lock);
+        while (slot->chunk != chunk || slot->stage != stage->id) {
+            pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+        }
+        pthread_mutex_unlock(&pipeline->lock);
+
+        profile_start(profiler);
+        stage->run(pipeline, slot);
+        profile_stage(profiler, (profile_stage_t) stage->id);
+
+        pthread_mutex_lock(&pipeline->lock);
+        if (++slot->stage == N_STAGES) {
+            // written, the slot is free for the chunk n_slots further on
+            slot->stage = STAGE_READ;
+            slot->chunk += pipeline->n_slots;
+        }
+        pthread_cond_broadcast(&pipeline->changed);
+        pthread_mutex_unlock(&pipeline->lock);
+    }
+
+    // the chunks add up to one frame per stage, the waits for the slots are left out
+    profile_frame(profiler, pipeline->input_filename);
+    profiler_destroy(profiler);
+    return NULL;
+}
+
+
+/**
+ * Converts input_filename to a 4:2:0 output_filename.tiff through a ring of ring_size strip slots.
+ * Returns the bytes held by the ring, the peak working set of the conversion.
+ */
+size_t convert_tiff_streaming(char* input_filename, char* output_filename, uint32 ring_size){
+    pipeline_t pipeline;
+    pthread_t threads[N_STAGES];
+    stage_t stages[N_STAGES] = {
+        {&pipeline, STAGE_READ, read_chunk},
+        {&pipeline, STAGE_CONVERT, convert_chunk},
+        {&pipeline, STAGE_DOWNSAMPLE, downsample_chunk},
+        {&pipeline, STAGE_WRITE, write_chunk},
+    };
+
+    printf("[+] Streaming \033[1;36m%s\033[0m\n", input_filename);
+    pipeline.input_filename = input_filename;
+    pipeline.input = TIFFOpen(input_filename, "r");
+    if (!pipeline.input) {
+        printf("[-] \033[0;31mCould not open %s for conversion\033[0m\n", input_filename);
+        exit(EXIT_FAILURE);
+    }
+    if (TIFFIsTiled(pipeline.input)) {
+        printf("[-] \033[0;31m%s is tiled, streaming needs strips\033[0m\n", input_filename);
+        exit(EXIT_FAILURE);
+    }
+    TIFFGetField(pipeline.input, TIFFTAG_IMAGEWIDTH, &pipeline.image.width);
+    TIFFGetField(pipeline.input, TIFFTAG_IMAGELENGTH, &pipeline.image.height);
+    TIFFGetFieldDefaulted(pipeline.input, TIFFTAG_ROWSPERSTRIP, &pipeline.rows_per_strip);
+    pipeline.image.stride = pipeline.image.width;
+    pipeline.image.channels = 4;
+    if (pipeline.rows_per_strip > pipeline.image.height) {
+        pipeline.rows_per_strip = pipeline.image.height;
+    }
+
+    uint16 bits_per_sample, photometric, planar_config, orientation, n_extra = 0;
+    uint16* extra_samples = NULL;
+    TIFFGetFieldDefaulted(pipeline.input, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+    TIFFGetFieldDefaulted(pipeline.input, TIFFTAG_SAMPLESPERPIXEL, &pipeline.samples_per_pixel);
+    TIFFGetFieldDefaulted(pipeline.input, TIFFTAG_PLANARCONFIG, &planar_config);
+    TIFFGetFieldDefaulted(pipeline.input, TIFFTAG_ORIENTATION, &orientation);
+    TIFFGetFieldDefaulted(pipeline.input, TIFFTAG_EXTRASAMPLES, &n_extra, &extra_samples);
+    if (!TIFFGetField(pipeline.input, TIFFTAG_PHOTOMETRIC, &photometric)) {
+        photometric = PHOTOMETRIC_MINISBLACK;
+    }
+    pipeline.associated_alpha = n_extra > 0 && extra_samples[0] == EXTRASAMPLE_ASSOCALPHA;
+
+    // unassociated alpha is premultiplied by TIFFReadRGBAStrip, those files keep going through it
+    pipeline.scanline = NULL;
+    if (bits_per_sample == 8 && photometric == PHOTOMETRIC_RGB && planar_config == PLANARCONFIG_CONTIG && orientation == ORIENTATION_TOPLEFT &&
+        (pipeline.samples_per_pixel == 3 || (pipeline.samples_per_pixel == 4 && (n_extra == 0 || extra_samples[0] != EXTRASAMPLE_UNASSALPHA)))) {
+        pipeline.scanline = malloc(TIFFScanlineSize(pipeline.input));
+    }
+
+    // chunks have to start on an even row, two strips per chunk when strips have an odd height
+    if (pipeline.scanline != NULL) {
+        pipeline.chunk_rows = (CHUNK_SIZE / (pipeline.image.width * sizeof(uint32))) & ~1u;
+        pipeline.chunk_rows = pipeline.chunk_rows < 2 ? 2 : pipeline.chunk_rows;
+        pipeline.chunk_rows = pipeline.chunk_rows > pipeline.image.height ? (pipeline.image.height + 1) & ~1u : pipeline.chunk_rows;
+    } else {
+        pipeline.chunk_rows = (pipeline.rows_per_strip & 1) ? pipeline.rows_per_strip * 2 : pipeline.rows_per_strip;
+    }
+    pipeline.n_chunks = (pipeline.image.height + pipeline.chunk_rows - 1) / pipeline.chunk_rows;
+    pipeline.n_slots = ring_size < 1 ? 1 : ring_size;
+    // one output strip per chunk
+    pipeline.output = open_tiff_output(output_filename, &pipeline.image, SUBSAMPLING_420, pipeline.chunk_rows);
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.changed, NULL);
+
+    image_t chunk = pipeline.image;
+    chunk.height = pipeline.chunk_rows;
+    size_t raster_size = (size_t) chunk.stride * chunk.height * sizeof(uint32);
+    size_t slot_size = raster_size + YCBCR_FRAME_SIZE(&chunk) + DOWNSAMPLED_FRAME_SIZE(&chunk);
+
+    pipeline.slots = calloc(pipeline.n_slots, sizeof(strip_slot_t));
+    if (pipeline.slots == NULL) {
+        printf("[-] \033[0;31mCould not allocate the strip buffers\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32 i = 0; i < pipeline.n_slots; ++i) {
+        pipeline.slots[i].raster = (uint32*) frame_alloc(raster_size);
+        pipeline.slots[i].ycbcr = frame_alloc(YCBCR_FRAME_SIZE(&chunk));
+        pipeline.slots[i].downsampled_ycbcr = frame_alloc(DOWNSAMPLED_FRAME_SIZE(&chunk));
+        pipeline.slots[i].chunk = i;
+        pipeline.slots[i].stage = STAGE_READ;
+        if (!pipeline.slots[i].raster || !pipeline.slots[i].ycbcr || !pipeline.slots[i].downsampled_ycbcr) {
+            printf("[-] \033[0;31mCould not allocate the strip buffers\033[0m\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("[o] Streaming %ux%u in %u chunks of %u rows through %u slots\n", pipeline.image.width, pipeline.image.height,
+           pipeline.n_chunks, pipeline.chunk_rows, pipeline.n_slots);
+    for (int id = 0; id < N_STAGES; ++id) {
+        if (pthread_create(&threads[id], NULL, stage_worker, &stages[id]) != 0) {
+            printf("[-] \033[0;31mCould not start the %s stage\033[0m\n", profile_stage_name((profile_stage_t) id));
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int id = 0; id < N_STAGES; ++id) {
+        pthread_join(threads[id], NULL);
+    }
+
+    for (uint32 i = 0; i < pipeline.n_slots; ++i) {
+        free(pipeline.slots[i].raster);
+        free(pipeline.slots[i].ycbcr);
+        free(pipeline.slots[i].downsampled_ycbcr);
+    }
+    free(pipeline.slots);
+    free(pipeline.scanline);
+    pthread_cond_destroy(&pipeline.changed);
+    pthread_mutex_destroy(&pipeline.lock);
+    TIFFClose(pipeline.output);
+    TIFFClose(pipeline.input);
+
+    return slot_size * pipeline.n_slots;
+}
@@ -0,0 +1,253 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/perf_event.h>
+#include "profile.h"
+
+// Wall and CPU time and the counters at one point of a thread, or their sums over the stages
+typedef struct profile_sample{
+    uint64 wall_ns;
+    uint64 cpu_ns;
+    uint64 counters[PROFILE_COUNTERS];
+    uint64 frames;
+} profile_sample_t;
+
+struct profiler{
+    char name[32];
+    int fds[PROFILE_COUNTERS];
+    int n_fds;                                      // the first one leads the group
+    profile_counter_t order[PROFILE_COUNTERS];      // counter of each value a group read returns
+    bool available[PROFILE_COUNTERS];
+    profile_sample_t last;
+    profile_sample_t frame[PROFILE_STAGES];
+    profile_sample_t total[PROFILE_STAGES];
+};
+
+static const struct { uint32 type; uint64 config; } counter_events[PROFILE_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+static const char* const stage_names[PROFILE_STAGES] = {"read", "convert", "downsample", "write"};
+
+static bool enabled = false;
+static FILE* trace = NULL;
+static const char* trace_name = NULL;
+static pthread_mutex_t totals_lock = PTHREAD_MUTEX_INITIALIZER;
+static profile_sample_t totals[PROFILE_STAGES];
+static uint32 n_profilers = 0;
+static uint32 counted[PROFILE_COUNTERS];           // profilers that had the counter, a total needs all of them
+
+
+bool profile_open(const char* trace_file){
+    trace = fopen(trace_file, "w");
+    if (trace == NULL) {
+        return false;
+    }
+    trace_name = trace_file;
+    fprintf(trace, "thread\tframe\tstage\twall_us\tcpu_us\tcycles\tinstructions\tcache_misses\tpage_faults\n");
+    enabled = true;
+    return true;
+}
+
+
+void profile_close(void){
+    if (!enabled) {
+        return;
+    }
+    enabled = false;
+    fclose(trace);
+
+    bool cycles = counted[COUNTER_CYCLES] == n_profilers;
+    bool instructions = counted[COUNTER_INSTRUCTIONS] == n_profilers;
+    bool cache_misses = counted[COUNTER_CACHE_MISSES] == n_profilers;
+
+    printf("[o] Stages of \033[1;36m%u\033[0m threads, every frame in %s%s\n", n_profilers, trace_name,
+           cycles ? "" : ", no hardware counters on this machine");
+    for (int stage = 0; stage < PROFILE_STAGES; ++stage) {
+        const profile_sample_t* total = &totals[stage];
+        if (total->frames == 0) {
+            continue;
+        }
+        // little CPU time for the wall time is I/O or waiting, a low IPC with many misses is memory
+        printf("    %-10s \033[1;36m%9.3f\033[0m ms/frame, %5.1f%% on CPU", stage_names[stage], total->wall_ns / 1e6 / total->frames,
+               total->wall_ns ? 100.0 * total->cpu_ns / total->wall_ns : 0.0);
+        if (cycles) {
+            printf(", %.3g cycles/frame", (double) total->counters[COUNTER_CYCLES] / total->frames);
+        }
+        if (cycles && instructions && total->counters[COUNTER_CYCLES] > 0) {
+            printf(", IPC %.2f", (double) total->counters[COUNTER_INSTRUCTIONS] / total->counters[COUNTER_CYCLES]);
+        }
+        if (instructions && cache_misses && total->counters[COUNTER_INSTRUCTIONS] > 0) {
+            printf(", %.2f LLC misses/1k instructions", 1000.0 * total->counters[COUNTER_CACHE_MISSES] / total->counters[COUNTER_INSTRUCTIONS]);
+        }
+        printf(", %.1f page faults/frame\n", (double) total->counters[COUNTER_PAGE_FAULTS] / total->frames);
+    }
+
+    memset(totals, 0, sizeof(totals));
+    memset(counted, 0, sizeof(counted));
+    n_profilers = 0;
+}
+
+
+bool profile_enabled(void){
+    return enabled;
+}
+
+
+// One counter of the calling thread, user space only so perf_event_paranoid 2 still allows it
+static int open_counter(profile_counter_t counter, int group){
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counter_events[counter].type;
+    attr.config = counter_events[counter].config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+
+static void read_sample(profiler_t* profiler, profile_sample_t* sample){
+    uint64 values[1 + PROFILE_COUNTERS];
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    sample->wall_ns = (uint64) now.tv_sec * 1000000000 + now.tv_nsec;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    sample->cpu_ns = (uint64) now.tv_sec * 1000000000 + now.tv_nsec;
+
+    // one read for the whole group: the number of values, then the values in the order they were opened
+    if (profiler->n_fds > 0 && read(profiler->fds[0], values, sizeof(values)) > 0) {
+        for (int i = 0; i < profiler->n_fds; ++i) {
+            sample->counters[profiler->order[i]] = values[1 + i];
+        }
+    }
+    if (profiler->n_fds == 0 || profiler->order[profiler->n_fds - 1] != COUNTER_PAGE_FAULTS) {
+        struct rusage usage;
+        getrusage(RUSAGE_THREAD, &usage);
+        sample->counters[COUNTER_PAGE_FAULTS] = usage.ru_minflt + usage.ru_majflt;
+    }
+}
+
+
+profiler_t* profiler_create(const char* thread_name){
+    if (!enabled) {
+        return NULL;
+    }
+    profiler_t* profiler = calloc(1, sizeof(profiler_t));
+    if (profiler == NULL) {
+        printf("[-] \033[0;31mCould not allocate the profiler of %s\033[0m\n", thread_name);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(profiler->name, sizeof(profiler->name), "%s", thread_name);
+
+    // without a PMU (most VMs) the hardware counters fail and the page faults lead the group
+    for (int counter = 0; counter < PROFILE_COUNTERS; ++counter) {
+        int fd = open_counter((profile_counter_t) counter, profiler->n_fds > 0 ? profiler->fds[0] : -1);
+        if (fd >= 0) {
+            profiler->fds[profiler->n_fds] = fd;
+            profiler->order[profiler->n_fds++] = (profile_counter_t) counter;
+            profiler->available[counter] = true;
+        }
+    }
+    profiler->available[COUNTER_PAGE_FAULTS] = true;
+    profile_start(profiler);
+    return profiler;
+}
+
+
+void profiler_destroy(profiler_t* profiler){
+    if (profiler == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&totals_lock);
+    for (int stage = 0; stage < PROFILE_STAGES; ++stage) {
+        totals[stage].wall_ns += profiler->total[stage].wall_ns;
+        totals[stage].cpu_ns += profiler->total[stage].cpu_ns;
+        totals[stage].frames += profiler->total[stage].frames;
+        for (int counter = 0; counter < PROFILE_COUNTERS; ++counter) {
+            totals[stage].counters[counter] += profiler->total[stage].counters[counter];
+        }
+    }
+    for (int counter = 0; counter < PROFILE_COUNTERS; ++counter) {
+        counted[counter] += profiler->available[counter];
+    }
+    ++n_profilers;
+    pthread_mutex_unlock(&totals_lock);
+
+    for (int i = 0; i < profiler->n_fds; ++i) {
+        close(profiler->fds[i]);
+    }
+    free(profiler);
+}
+
+
+void profile_start(profiler_t* profiler){
+    if (profiler != NULL) {
+        read_sample(profiler, &profiler->last);
+    }
+}
+
+
+void profile_stage(profiler_t* profiler, profile_stage_t stage){
+    profile_sample_t now;
+    if (profiler == NULL) {
+        return;
+    }
+    read_sample(profiler, &now);
+    profiler->frame[stage].wall_ns += now.wall_ns - profiler->last.wall_ns;
+    profiler->frame[stage].cpu_ns += now.cpu_ns - profiler->last.cpu_ns;
+    for (int counter = 0; counter < PROFILE_COUNTERS; ++counter) {
+        profiler->frame[stage].counters[counter] += now.counters[counter] - profiler->last.counters[counter];
+    }
+    profiler->frame[stage].frames = 1;
+    profiler->last = now;
+}
+
+
+void profile_frame(profiler_t* profiler, const char* frame){
+    if (profiler == NULL) {
+        return;
+    }
+    // the lines of one frame stay together when several threads finish at once
+    flockfile(trace);
+    for (int stage = 0; stage < PROFILE_STAGES; ++stage) {
+        profile_sample_t* sample = &profiler->frame[stage];
+        if (sample->frames == 0) {
+            continue;
+        }
+        fprintf(trace, "%s\t%s\t%s\t%.1f\t%.1f", profiler->name, frame, stage_names[stage], sample->wall_ns / 1e3, sample->cpu_ns / 1e3);
+        for (int counter = 0; counter < PROFILE_COUNTERS; ++counter) {
+            if (profiler->available[counter]) {
+                fprintf(trace, "\t%" PRIu64, sample->counters[counter]);
+            } else {
+                fprintf(trace, "\t-");
+            }
+        }
+        fprintf(trace, "\n");
+
+        profiler->total[stage].wall_ns += sample->wall_ns;
+        profiler->total[stage].cpu_ns += sample->cpu_ns;
+        profiler->total[stage].frames += 1;
+        for (int counter = 0; counter < PROFILE_COUNTERS; ++counter) {
+            profiler->total[stage].counters[counter] += sample->counters[counter];
+        }
+        memset(sample, 0, sizeof(profile_sample_t));
+    }
+    funlockfile(trace);
+}
+
+
+const char* profile_stage_name(profile_stage_t stage){
+    return stage_names[stage];
+}
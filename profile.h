@@ -0,0 +1,47 @@
+#ifndef COLOR_SPACE_CONVERSION_PROFILE_H
+#define COLOR_SPACE_CONVERSION_PROFILE_H
+
+#include <stdbool.h>
+#include <tiffio.h>
+
+/**
+ * Optional per-stage instrumentation of the batch and streaming conversions. Every thread that runs
+ * stages has its own profiler, which reads wall time and, through perf_event_open, the cycles,
+ * instructions, last level cache misses and page faults of that thread at each stage boundary. Once a
+ * frame is done its stages go to the trace file, one line per thread, frame and stage, and into the
+ * totals printed by profile_close(). Counters the kernel or the machine does not offer (no PMU in
+ * a VM, perf_event_paranoid) are left out of both; page faults come from getrusage() then.
+ *
+ * Until profile_open() every profiler is NULL and the calls return at once, so the stages cost one
+ * branch each when profiling is off.
+ */
+typedef enum { PROFILE_READ, PROFILE_CONVERT, PROFILE_DOWNSAMPLE, PROFILE_WRITE } profile_stage_t;
+#define PROFILE_STAGES 4
+
+typedef enum { COUNTER_CYCLES, COUNTER_INSTRUCTIONS, COUNTER_CACHE_MISSES, COUNTER_PAGE_FAULTS } profile_counter_t;
+#define PROFILE_COUNTERS 4
+
+typedef struct profiler profiler_t;
+
+// Turns profiling on and starts trace_file, a tab-separated table; false when it cannot be written
+bool profile_open(const char* trace_file);
+// Prints the totals of every stage over every thread and closes the trace, after the profilers are destroyed
+void profile_close(void);
+// Between profile_open() and profile_close()
+bool profile_enabled(void);
+
+// Profiler of the calling thread, which has to be the one running the stages; NULL when profiling is off
+profiler_t* profiler_create(const char* thread_name);
+void profiler_destroy(profiler_t* profiler);
+
+// Starts counting at the current point, time spent waiting before it belongs to no stage
+void profile_start(profiler_t* profiler);
+// Everything since the last start or stage belongs to `stage`, the next stage starts here
+void profile_stage(profiler_t* profiler, profile_stage_t stage);
+// "read", "convert", "downsample" or "write"
+const char* profile_stage_name(profile_stage_t stage);
+
+// Writes the stages of frame to the trace and starts the next frame
+void profile_frame(profiler_t* profiler, const char* frame);
+
+#endif //COLOR_SPACE_CONVERSION_PROFILE_H
@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "conversion.h"
+#include "thread_pool.h"
+#include "frame_pool.h"
+#include "profile.h"
+
+/**
+ * Raw video through pipes: fixed-size RGB frames come in on one file descriptor and leave as planar
+ * 4:2:0 on another, the way ffmpeg -f rawvideo reads and writes them. Reading, converting and writing
+ * run on their own threads over three slots, so while frame n is converted frame n+1 is read and frame
+ * n-1 written. The conversion runs in row bands on the default pool, or on the convert thread alone
+ * while profiling, whose counters would not see the pool workers.
+ */
+
+// A slot per stage, one fills while the second one is converted and the third one written
+#define PIPE_SLOTS 3
+
+enum { PIPE_READ, PIPE_CONVERT, PIPE_WRITE, PIPE_STAGES };
+
+typedef struct raw_slot{
+    uint8* input;               // one frame as read
+    uint8* frame;               // PLANAR_FRAME_SIZE output frame
+    uint64 index;               // frame the slot holds or is waiting for
+    int stage;                  // next stage to run on the slot
+    bool last;                  // the input ended, nothing was read into the slot
+} raw_slot_t;
+
+typedef struct raw_pipe{
+    int input_fd;
+    int output_fd;
+    image_t image;
+    pixel_format_t format;
+    planar_layout_t layout;
+    size_t frame_bytes;
+    uint64 frames;              // written, only the write stage counts them
+    raw_slot_t slots[PIPE_SLOTS];
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} raw_pipe_t;
+
+typedef struct pipe_stage{
+    raw_pipe_t* pipe;
+    int id;
+    profile_stage_t profile;
+    void (*run)(raw_pipe_t* pipe, raw_slot_t* slot);
+} pipe_stage_t;
+
+typedef struct pipe_band{
+    raw_pipe_t* pipe;
+    raw_slot_t* slot;
+} pipe_band_t;
+
+
+// Fills the input of the slot with one whole frame, a short read at the end of the input ends the stream
+static void read_frame(raw_pipe_t* pipe, raw_slot_t* slot){
+    size_t done = 0;
+
+    while (done < pipe->frame_bytes) {
+        ssize_t n = read(pipe->input_fd, slot->input + done, pipe->frame_bytes - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += (size_t) n;
+    }
+    if (done > 0 && done < pipe->frame_bytes) {
+        printf("[-] \033[0;31mThe input ends %zu bytes into a frame, dropped it\033[0m\n", done);
+    }
+    slot->last = done < pipe->frame_bytes;
+}
+
+
+static void convert_band(void* args, uint32 first_row, uint32 rows){
+    raw_pipe_t* pipe = ((pipe_band_t*) args)->pipe;
+    raw_slot_t* slot = ((pipe_band_t*) args)->slot;
+    const image_t* image = &pipe->image;
+    planes_t planes = frame_planes(slot->frame, image, pipe->layout);
+    planes_t band_planes = planes_at_row(&planes, image, first_row);
+    size_t first_pixel = (size_t) first_row * image->stride;
+
+    // every format is read as it is, none goes through an RGBA copy first
+    kernels->convert420_planar_packed(slot->input + first_pixel * pixel_formats[pipe->format].bytes, pipe->format, &band_planes, image, rows);
+}
+
+
+static void convert_frame(raw_pipe_t* pipe, raw_slot_t* slot){
+    pipe_band_t band = {.pipe = pipe, .slot = slot};
+
+    if (profile_enabled()) {
+        convert_band(&band, 0, pipe->image.height);
+        return;
+    }
+    thread_pool_run(thread_pool_default(), convert_band, &band, pipe->image.height, 0);
+}
+
+
+// With stride == width the planes are packed the way the rawvideo muxers expect, one write per frame
+static void write_frame(raw_pipe_t* pipe, raw_slot_t* slot){
+    size_t size = PLANAR_FRAME_SIZE(&pipe->image);
+    size_t done = 0;
+
+    while (done < size) {
+        ssize_t n = write(pipe->output_fd, slot->frame + done, size - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            printf("[-] \033[0;31mWriting frame %" PRIu64 " failed: %s\033[0m\n", slot->index, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        done += (size_t) n;
+    }
+    ++pipe->frames;
+}
+
+
+// Runs one stage over every frame in order until the slot marked last reaches it
+static void* stage_worker(void* args){
+    pipe_stage_t* stage = (pipe_stage_t*) args;
+    raw_pipe_t* pipe = stage->pipe;
+    char name[32];
+    bool last = false;
+
+    snprintf(name, sizeof(name), "pipe %s", profile_stage_name(stage->profile));
+    profiler_t* profiler = profiler_create(name);
+
+    for (uint64 index = 0; !last; ++index) {
+        raw_slot_t* slot = &pipe->slots[index % PIPE_SLOTS];
+
+        pthread_mutex_lock(&pipe->lock);
+        while (slot->index != index || slot->stage != stage->id) {
+            pthread_cond_wait(&pipe->changed, &pipe->lock);
+        }
+        pthread_mutex_unlock(&pipe->lock);
+
+        if (!slot->last) {
+            profile_start(profiler);
+            stage->run(pipe, slot);
+            profile_stage(profiler, stage->profile);
+        }
+        last = slot->last;
+        if (!last) {
+            snprintf(name, sizeof(name), "frame %" PRIu64, index);
+            profile_frame(profiler, name);
+        }
+
+        pthread_mutex_lock(&pipe->lock);
+        if (++slot->stage == PIPE_STAGES) {
+            slot->stage = PIPE_READ;
+            slot->index += PIPE_SLOTS;
+        }
+        pthread_cond_broadcast(&pipe->changed);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+
+    profiler_destroy(profiler);
+    return NULL;
+}
+
+
+uint64 convert_raw_pipe(int input_fd, int output_fd, const image_t* image, pixel_format_t format, planar_layout_t layout){
+    raw_pipe_t pipe = {.input_fd = input_fd, .output_fd = output_fd, .image = *image, .format = format, .layout = layout,
+                       .frame_bytes = (size_t) image->width * image->height * pixel_formats[format].bytes};
+    pthread_t threads[PIPE_STAGES];
+    pipe_stage_t stages[PIPE_STAGES] = {
+        {.pipe = &pipe, .id = PIPE_READ, .profile = PROFILE_READ, .run = read_frame},
+        {.pipe = &pipe, .id = PIPE_CONVERT, .profile = PROFILE_CONVERT, .run = convert_frame},
+        {.pipe = &pipe, .id = PIPE_WRITE, .profile = PROFILE_WRITE, .run = write_frame},
+    };
+    struct timeval stop, start;
+
+    pipe.image.stride = image->width;
+    pthread_mutex_init(&pipe.lock, NULL);
+    pthread_cond_init(&pipe.changed, NULL);
+    for (uint32 i = 0; i < PIPE_SLOTS; ++i) {
+        raw_slot_t* slot = &pipe.slots[i];
+        slot->input = frame_alloc(pipe.frame_bytes);
+        slot->frame = frame_alloc(PLANAR_FRAME_SIZE(&pipe.image));
+        slot->index = i;
+        if (!slot->input || !slot->frame) {
+            printf("[-] \033[0;31mCould not allocate the frame buffers\033[0m\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("[+] Converting %ux%u %s frames from the input pipe to %s\n", image->width, image->height, pixel_formats[format].name,
+           layout == LAYOUT_I420 ? "I420" : "NV12");
+    gettimeofday(&start, NULL);
+    for (int id = 0; id < PIPE_STAGES; ++id) {
+        if (pthread_create(&threads[id], NULL, stage_worker, &stages[id]) != 0) {
+            printf("[-] \033[0;31mCould not start the %s stage\033[0m\n", profile_stage_name(stages[id].profile));
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int id = 0; id < PIPE_STAGES; ++id) {
+        pthread_join(threads[id], NULL);
+    }
+    gettimeofday(&stop, NULL);
+
+    uint64 frames = pipe.frames;
+    double seconds = (double) ((stop.tv_sec - start.tv_sec) * 1000000 + stop.tv_usec - start.tv_usec) / 1e6;
+    printf("[o] Converted \033[1;36m%" PRIu64 "\033[0m frames in \033[1;36m%.3f\033[0m s, \033[1;36m%.1f\033[0m frames/s, %.1f MB/s in\n",
+           frames, seconds, frames / seconds, frames * pipe.frame_bytes / seconds / 1e6);
+
+    for (uint32 i = 0; i < PIPE_SLOTS; ++i) {
+        free(pipe.slots[i].input);
+        free(pipe.slots[i].frame);
+    }
+    pthread_cond_destroy(&pipe.changed);
+    pthread_mutex_destroy(&pipe.lock);
+    return frames;
+}
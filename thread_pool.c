@@ -0,0 +1,263 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "thread_pool.h"
+
+// Bands per thread when the caller lets the pool pick, enough to even out uneven bands
+#define BANDS_PER_THREAD 4
+
+struct thread_pool{
+    pthread_t* threads;
+    int n_threads;              // workers including the calling thread
+    pthread_mutex_t run_lock;   // one job at a time when several threads share the pool
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64 generation;          // bumped for every job so sleeping workers know there is a new one
+    int running;                // workers that have not finished the current job yet
+    bool shutdown;
+
+    // current job
+    band_fn_t fn;
+    void* args;
+    uint32 rows;
+    uint32 band_rows;
+    uint32 n_bands;
+    uint32 next_band;           // next band to claim, atomic
+};
+
+static thread_pool_t* default_pool = NULL;
+static pthread_mutex_t default_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void run_bands(thread_pool_t* pool){
+    uint32 band;
+
+    while ((band = __atomic_fetch_add(&pool->next_band, 1, __ATOMIC_RELAXED)) < pool->n_bands) {
+        uint32 first_row = band * pool->band_rows;
+        uint32 rows = (first_row + pool->band_rows > pool->rows) ? pool->rows - first_row : pool->band_rows;
+        pool->fn(pool->args, first_row, rows);
+    }
+}
+
+
+static void* pool_worker(void* args){
+    thread_pool_t* pool = (thread_pool_t*) args;
+    uint64 seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->shutdown && pool->generation == seen) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->shutdown) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_bands(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+
+thread_pool_t* thread_pool_create(int n_threads, const cpu_set_t* cpus){
+    cpu_set_t allowed;
+    int cpu = -1;
+
+    if (cpus == NULL) {
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0) {
+            CPU_SET(0, &allowed);
+        }
+        cpus = &allowed;
+    }
+    if (n_threads <= 0) {
+        n_threads = CPU_COUNT(cpus) > 0 ? CPU_COUNT(cpus) : 1;
+    }
+
+    thread_pool_t* pool = calloc(1, sizeof(thread_pool_t));
+    if (pool == NULL || (pool->threads = malloc(sizeof(pthread_t) * n_threads)) == NULL) {
+        free(pool);
+        return NULL;
+    }
+    pool->n_threads = n_threads;
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // the calling thread is worker 0, the others are pinned round-robin to the CPUs of the set
+    for (int id = 1; id < n_threads; ++id) {
+        if (thread_create_pinned(&pool->threads[id], &cpu, cpus, pool_worker, pool) != 0) {
+            // a job waits for n_threads - 1 workers, so the pool only counts the ones that started
+            printf("[-] \033[0;31mStarted %d of %d pool threads\033[0m\n", id, n_threads);
+            pool->n_threads = id;
+            break;
+        }
+    }
+
+    return pool;
+}
+
+
+void thread_pool_destroy(thread_pool_t* pool){
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int id = 1; id < pool->n_threads; ++id) {
+        pthread_join(pool->threads[id], NULL);
+    }
+
+    pthread_mutex_lock(&default_pool_lock);
+    if (default_pool == pool) {
+        default_pool = NULL;
+    }
+    pthread_mutex_unlock(&default_pool_lock);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->run_lock);
+    free(pool->threads);
+    free(pool);
+}
+
+
+int thread_pool_size(const thread_pool_t* pool){
+    return pool->n_threads;
+}
+
+
+void thread_pool_run(thread_pool_t* pool, band_fn_t fn, void* args, uint32 rows, uint32 band_rows){
+    if (rows == 0) {
+        return;
+    }
+    if (band_rows == 0) {
+        band_rows = rows / (pool->n_threads * BANDS_PER_THREAD);
+    }
+    // even band starts keep every 2x2 block inside one band
+    band_rows = (band_rows < 2) ? 2 : (band_rows + 1) & ~1u;
+
+    // a single thread pool runs the bands on the caller without touching the pool, so any number of
+    // threads (batch workers, say) can share it without waiting for each other
+    if (pool->n_threads == 1) {
+        for (uint32 first_row = 0; first_row < rows; first_row+=band_rows) {
+            fn(args, first_row, (first_row + band_rows > rows) ? rows - first_row : band_rows);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->args = args;
+    pool->rows = rows;
+    pool->band_rows = band_rows;
+    pool->n_bands = (rows + band_rows - 1) / band_rows;
+    pool->next_band = 0;
+    pool->running = pool->n_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_bands(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run_lock);
+}
+
+
+thread_pool_t* thread_pool_default(void){
+    pthread_mutex_lock(&default_pool_lock);
+    if (default_pool == NULL && (default_pool = thread_pool_create(0, NULL)) == NULL) {
+        // the frame kernels have no way to report it, so there is nothing to run them on
+        printf("[-] \033[0;31mCould not create the thread pool\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+    thread_pool_t* pool = default_pool;
+    pthread_mutex_unlock(&default_pool_lock);
+    return pool;
+}
+
+
+void thread_pool_set_default(thread_pool_t* pool){
+    pthread_mutex_lock(&default_pool_lock);
+    default_pool = pool;
+    pthread_mutex_unlock(&default_pool_lock);
+}
+
+
+int thread_create_pinned(pthread_t* thread, int* cpu, const cpu_set_t* cpus, void* (*fn)(void*), void* args){
+    cpu_set_t pinned;
+    pthread_attr_t attr;
+    int created;
+
+    do {
+        *cpu = (*cpu + 1) % CPU_SETSIZE;
+    } while (CPU_COUNT(cpus) > 0 && !CPU_ISSET(*cpu, cpus));
+
+    pthread_attr_init(&attr);
+    CPU_ZERO(&pinned);
+    CPU_SET(*cpu, &pinned);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &pinned);
+    created = pthread_create(thread, &attr, fn, args);
+    if (created != 0) {
+        // the CPU may not be available to us, run unpinned instead
+        created = pthread_create(thread, NULL, fn, args);
+    }
+    pthread_attr_destroy(&attr);
+    return created;
+}
+
+
+bool parse_cpu_list(const char* list, cpu_set_t* cpus){
+    char* end;
+
+    CPU_ZERO(cpus);
+    while (*list != '\0') {
+        long first = strtol(list, &end, 10);
+        long last = first;
+        if (end == list || first < 0) {
+            return false;
+        }
+        if (*end == '-') {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+            if (end == list || last < first) {
+                return false;
+            }
+        }
+        if (last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            CPU_SET(cpu, cpus);
+        }
+        if (*end == ',') {
+            ++end;
+        } else if (*end != '\0') {
+            return false;
+        }
+        list = end;
+    }
+    return CPU_COUNT(cpus) > 0;
+}
@@ -0,0 +1,40 @@
+#ifndef COLOR_SPACE_CONVERSION_THREAD_POOL_H
+#define COLOR_SPACE_CONVERSION_THREAD_POOL_H
+
+#include <stdbool.h>
+#include <sched.h>
+#include <pthread.h>
+#include <tiffio.h>
+
+/**
+ * Long-lived worker pool for the multithreaded kernels. A job is a range of rows cut into bands, idle
+ * workers (and the calling thread) claim the next free band until none are left, so a slow band does
+ * not hold the others back. Needs _GNU_SOURCE for cpu_set_t.
+ */
+typedef struct thread_pool thread_pool_t;
+
+// Processes `rows` rows of the frame starting at first_row
+typedef void (*band_fn_t)(void* args, uint32 first_row, uint32 rows);
+
+// n_threads <= 0 uses one thread per CPU of `cpus`, cpus == NULL uses the CPUs the process may run on.
+// NULL if the pool cannot be allocated; threads that fail to start leave a smaller pool, see thread_pool_size()
+thread_pool_t* thread_pool_create(int n_threads, const cpu_set_t* cpus);
+void thread_pool_destroy(thread_pool_t* pool);
+int thread_pool_size(const thread_pool_t* pool);
+
+// Runs fn over rows [0, rows) and returns once every band is done. band_rows == 0 picks a band size
+// from the pool size; bands always start on an even row so they can be downsampled on their own.
+void thread_pool_run(thread_pool_t* pool, band_fn_t fn, void* args, uint32 rows, uint32 band_rows);
+
+// Pool used by the multithreaded frame kernels, created on first use unless one was set before; exits if that fails
+thread_pool_t* thread_pool_default(void);
+void thread_pool_set_default(thread_pool_t* pool);
+
+// Starts fn on the CPU of the set after *cpu, round-robin like the pool workers, unpinned when that CPU
+// is not available; returns what pthread_create() does
+int thread_create_pinned(pthread_t* thread, int* cpu, const cpu_set_t* cpus, void* (*fn)(void*), void* args);
+
+// Parses a CPU list such as "0-3,8" into cpus
+bool parse_cpu_list(const char* list, cpu_set_t* cpus);
+
+#endif //COLOR_SPACE_CONVERSION_THREAD_POOL_H
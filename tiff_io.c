@@ -0,0 +1,536 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "conversion.h"
+#include "thread_pool.h"
+
+// Target size of an output strip, big enough to keep the syscalls and codec setup cheap
+#define TIFF_STRIP_SIZE (256 * 1024)
+
+static uint16 output_compression = COMPRESSION_NONE;
+
+
+/**
+ * Decodes filename into *raster as top-left ABGR pixels without printing anything, for batch conversion.
+ * The raster is reused, and grown along with *capacity (in pixels) when the image does not fit.
+ */
+bool read_tiff_raster(const char* filename, image_t* image, uint32** raster, size_t* capacity){
+    TIFF* tiff_image = TIFFOpen(filename, "r");
+    if (!tiff_image) {
+        return false;
+    }
+    TIFFGetField(tiff_image, TIFFTAG_IMAGEWIDTH, &image->width);
+    TIFFGetField(tiff_image, TIFFTAG_IMAGELENGTH, &image->height);
+    image->stride = image->width;
+    image->channels = 4;
+    size_t n_pixels = (size_t) image->stride * image->height;
+
+    if (n_pixels > *capacity) {
+        free(*raster);
+        *raster = (uint32*) malloc(n_pixels * sizeof(uint32));
+        *capacity = (*raster != NULL) ? n_pixels : 0;
+    }
+    bool read = *raster != NULL && TIFFReadRGBAImageOriented(tiff_image, image->width, image->height, *raster, ORIENTATION_TOPLEFT, 0);
+    TIFFClose(tiff_image);
+    return read;
+}
+
+
+// Frame size from the header alone, nothing is decoded
+bool read_tiff_size(const char* filename, image_t* image){
+    TIFF* tiff_image = TIFFOpen(filename, "r");
+    if (!tiff_image) {
+        return false;
+    }
+    TIFFGetField(tiff_image, TIFFTAG_IMAGEWIDTH, &image->width);
+    TIFFGetField(tiff_image, TIFFTAG_IMAGELENGTH, &image->height);
+    image->stride = image->width;
+    image->channels = 4;
+    TIFFClose(tiff_image);
+    return true;
+}
+
+
+uint32 * read_tiff_image(char* filename, image_t* image){
+    uint32* image_data = NULL;
+    size_t capacity = 0;
+
+    printf("[+] Opening \033[1;36m%s\033[0m\n", filename);
+    if (!read_tiff_raster(filename, image, &image_data, &capacity)) {
+        printf("[-] \033[0;31mCould not read %s for conversion\033[0m\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    printf("[o] Read Image (%ux%u)\n", image->width, image->height);
+    printf("[+] \033[1;32mSuccessfully read image to memory\033[0m\n");
+
+    return image_data;
+}
+
+
+/**
+ * Reads a 48-bit RGB (or 64-bit RGBA) image without going through the 8-bit RGBA raster. The strips
+ * are decoded straight into the frame so the kernels get the native 16-bit samples. Returns NULL when
+ * the image is not 16-bit contiguous RGB so the caller can fall back to read_tiff_image.
+ */
+uint16* read_tiff_image_rgb48(char* filename, image_t* image){
+    uint16 bits_per_sample, samples_per_pixel, planar_config, photometric;
+    printf("[+] Opening \033[1;36m%s\033[0m\n", filename);
+    TIFF* tiff_image = TIFFOpen(filename, "r");
+    if (!tiff_image) {
+        printf("[-] \033[0;31mCould not open %s for conversion\033[0m\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    TIFFGetField(tiff_image, TIFFTAG_IMAGEWIDTH, &image->width);
+    TIFFGetField(tiff_image, TIFFTAG_IMAGELENGTH, &image->height);
+    TIFFGetFieldDefaulted(tiff_image, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+    TIFFGetFieldDefaulted(tiff_image, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+    TIFFGetFieldDefaulted(tiff_image, TIFFTAG_PLANARCONFIG, &planar_config);
+    TIFFGetFieldDefaulted(tiff_image, TIFFTAG_PHOTOMETRIC, &photometric);
+
+    if (bits_per_sample != 16 || samples_per_pixel < 3 || samples_per_pixel > 4 || planar_config != PLANARCONFIG_CONTIG ||
+        photometric != PHOTOMETRIC_RGB || TIFFIsTiled(tiff_image)){
+        printf("[-] \033[0;31m%s is not a 48-bit RGB strip image\033[0m\n", filename);
+        TIFFClose(tiff_image);
+        return NULL;
+    }
+
+    image->stride = image->width;
+    image->channels = samples_per_pixel;
+    uint16* image_data = (uint16*) malloc((size_t) image->stride * image->height * image->channels * sizeof(uint16));
+
+    if (image_data == NULL){
+        printf("[-] \033[0;31mCould not allocate memory to store image file\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("[o] Reading 48-bit Image (%ux%u)\n", image->width, image->height);
+    // strips hold whole rows in order, so each one is decoded right after the previous one
+    uint8* strip_data = (uint8*) image_data;
+    for (uint32 strip = 0; strip < TIFFNumberOfStrips(tiff_image); ++strip) {
+        tmsize_t strip_size = TIFFReadEncodedStrip(tiff_image, strip, strip_data, (tmsize_t) -1);
+        if (strip_size < 0){
+            printf("[-] \033[0;31mReading strip %u failed!\033[0m\n", strip);
+            exit(EXIT_FAILURE);
+        }
+        strip_data += strip_size;
+    }
+    TIFFClose(tiff_image);
+
+    printf("[+] \033[1;32mSuccessfully read image to memory\033[0m\n");
+
+    return image_data;
+}
+
+
+/**
+ * Maps an uncompressed file whose strips already are the frame the kernels read: whole rows one after
+ * the other, top-left, in host byte order and aligned for the samples. The directory is only used to
+ * find the strips. Returns the first pixel inside the mapping, or NULL when the file has to be decoded.
+ */
+static const void* map_tiff_strips(const char* filename, uint16 bits_per_sample, image_t* image, mapped_file_t* mapping){
+    uint16 file_bits, samples_per_pixel, compression, planar_config, photometric, orientation, sample_format;
+    uint16 n_extra = 0, *extra_samples = NULL;
+    struct stat info;
+    const void* pixels = NULL;
+
+    TIFF* tiff_image = TIFFOpen(filename, "r");
+    if (!tiff_image) {
+        return NULL;
+    }
+    TIFFGetField(tiff_image, TIFFTAG_IMAGEWIDTH, &image->width);
+    TIFFGetField(tiff_image, TIFFTAG_IMAGELENGTH, &image->height);
+    TIFFGetFieldDefaulted(tiff_image, TIFFTAG_BITSPERSAMPLE, &file_bits);
+    TIFFGetFieldDefaulted(tiff_image, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+    TIFFGetFieldDefaulted(tiff_image, TIFFTAG_COMPRESSION, &compression);
+    TIFFGetFieldDefaulted(tiff_image, TIFFTAG_PLANARCONFIG, &planar_config);
+    TIFFGetFieldDefaulted(tiff_image, TIFFTAG_PHOTOMETRIC, &photometric);
+    TIFFGetFieldDefaulted(tiff_image, TIFFTAG_ORIENTATION, &orientation);
+    TIFFGetFieldDefaulted(tiff_image, TIFFTAG_SAMPLEFORMAT, &sample_format);
+    TIFFGetField(tiff_image, TIFFTAG_EXTRASAMPLES, &n_extra, &extra_samples);
+    image->stride = image->width;
+    image->channels = samples_per_pixel;
+
+    /*
+     * The ABGR raster is RGBA bytes on a little-endian host, but libtiff premultiplies unassociated alpha
+     * into it, so only files without alpha to apply can stand in for it
+     */
+    bool raster_layout = samples_per_pixel == 4 && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ &&
+                         (n_extra == 0 || extra_samples[0] != EXTRASAMPLE_UNASSALPHA);
+    bool layout = (bits_per_sample == 8) ? raster_layout : (samples_per_pixel >= 3 && samples_per_pixel <= 4 && !TIFFIsByteSwapped(tiff_image));
+
+    if (file_bits != bits_per_sample || !layout || compression != COMPRESSION_NONE || planar_config != PLANARCONFIG_CONTIG ||
+        photometric != PHOTOMETRIC_RGB || orientation != ORIENTATION_TOPLEFT || sample_format != SAMPLEFORMAT_UINT ||
+        TIFFIsTiled(tiff_image) || image->width == 0 || image->height == 0 || fstat(TIFFFileno(tiff_image), &info) != 0) {
+        TIFFClose(tiff_image);
+        return NULL;
+    }
+
+    uint32 rows_per_strip;
+    TIFFGetFieldDefaulted(tiff_image, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+    rows_per_strip = rows_per_strip < image->height ? rows_per_strip : image->height;
+    size_t row_size = (size_t) image->width * samples_per_pixel * bits_per_sample / 8;
+    uint64 first = TIFFGetStrileOffset(tiff_image, 0);
+    bool contiguous = first % (bits_per_sample == 8 ? sizeof(uint32) : sizeof(uint16)) == 0 &&
+                      first + row_size * image->height <= (uint64) info.st_size;
+
+    for (uint32 strip = 0; contiguous && strip < TIFFNumberOfStrips(tiff_image); ++strip) {
+        uint32 first_row = strip * rows_per_strip;
+        uint32 rows = (first_row + rows_per_strip > image->height) ? image->height - first_row : rows_per_strip;
+        contiguous = TIFFGetStrileOffset(tiff_image, strip) == first + first_row * row_size &&
+                     TIFFGetStrileByteCount(tiff_image, strip) >= rows * row_size;
+    }
+
+    if (contiguous) {
+        void* base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, TIFFFileno(tiff_image), 0);
+        if (base != MAP_FAILED) {
+            // the kernels walk the rows once from the top, read ahead as far as the kernel lets us
+            uint8* start = (uint8*) base + (first & ~(uint64) (sysconf(_SC_PAGESIZE) - 1));
+            size_t length = (uint8*) base + first + row_size * image->height - start;
+            madvise(start, length, MADV_SEQUENTIAL);
+            madvise(start, length, MADV_WILLNEED);
+            mapping->base = base;
+            mapping->length = info.st_size;
+            pixels = (const uint8*) base + first;
+        }
+    }
+    // the mapping outlives the descriptor
+    TIFFClose(tiff_image);
+    return pixels;
+}
+
+
+const uint32* map_tiff_raster(const char* filename, image_t* image, mapped_file_t* mapping){
+    return map_tiff_strips(filename, 8, image, mapping);
+}
+
+
+const uint16* map_tiff_rgb48(const char* filename, image_t* image, mapped_file_t* mapping){
+    return map_tiff_strips(filename, 16, image, mapping);
+}
+
+
+void unmap_tiff(mapped_file_t* mapping){
+    if (mapping->base != NULL) {
+        munmap(mapping->base, mapping->length);
+        mapping->base = NULL;
+    }
+}
+
+
+/*
+ * Strips are encoded on their own in a throwaway in-memory TIFF, so any libtiff codec can run on several
+ * threads at once; the encoded bytes are then appended to the real file with TIFFWriteRawStrip.
+ */
+typedef struct memory_file{
+    uint8* data;
+    toff_t size;
+    toff_t capacity;
+    toff_t position;
+} memory_file_t;
+
+static tmsize_t memory_read(thandle_t handle, void* buffer, tmsize_t size){
+    memory_file_t* file = (memory_file_t*) handle;
+    tmsize_t available = (file->position < file->size) ? (tmsize_t) (file->size - file->position) : 0;
+    size = size < available ? size : available;
+    memcpy(buffer, file->data + file->position, size);
+    file->position += size;
+    return size;
+}
+
+static tmsize_t memory_write(thandle_t handle, void* buffer, tmsize_t size){
+    memory_file_t* file = (memory_file_t*) handle;
+    if (file->position + size > file->capacity) {
+        toff_t capacity = (file->position + size) * 2;
+        uint8* data = realloc(file->data, capacity);
+        if (data == NULL) {
+            return -1;
+        }
+        file->data = data;
+        file->capacity = capacity;
+    }
+    memcpy(file->data + file->position, buffer, size);
+    file->position += size;
+    file->size = file->position > file->size ? file->position : file->size;
+    return size;
+}
+
+static toff_t memory_seek(thandle_t handle, toff_t offset, int whence){
+    memory_file_t* file = (memory_file_t*) handle;
+    file->position = (whence == SEEK_SET) ? offset : (whence == SEEK_CUR) ? file->position + offset : file->size + offset;
+    return file->position;
+}
+
+static int memory_close(thandle_t handle){
+    (void) handle;
+    return 0;
+}
+
+static toff_t memory_size(thandle_t handle){
+    return ((memory_file_t*) handle)->size;
+}
+
+static int memory_map(thandle_t handle, void** base, toff_t* size){
+    (void) handle;
+    (void) base;
+    (void) size;
+    return 0;
+}
+
+static void memory_unmap(thandle_t handle, void* base, toff_t size){
+    (void) handle;
+    (void) base;
+    (void) size;
+}
+
+
+typedef struct encoded_strip{
+    uint8* data;
+    tmsize_t size;
+} encoded_strip_t;
+
+typedef struct strip_job{
+    TIFF* tiff_output;
+    const uint8* image;
+    const image_t* frame;
+    int cb_subsampling;
+    int cr_subsampling;
+    uint16 compression;
+    uint32 rows_per_strip;
+    encoded_strip_t* strips;
+} strip_job_t;
+
+
+// Bytes of one row of sampling blocks, packed to the image width in the file or padded to the stride in memory
+static size_t block_row_size(uint32 pixels, int cb_subsampling, int cr_subsampling){
+    return (size_t) ((pixels + cb_subsampling - 1) / cb_subsampling) * (cb_subsampling * cr_subsampling + 2);
+}
+
+
+/**
+ * Returns the `rows` rows of the job starting at its row first_row laid out as a strip of the file. Unpadded frames
+ * already are, the pointer into the frame is returned as is; padded ones are packed into *copy.
+ */
+static const uint8* strip_data(const strip_job_t* job, uint32 first_row, uint32 rows, tmsize_t* size, uint8** copy){
+    size_t file_row_size = block_row_size(job->frame->width, job->cb_subsampling, job->cr_subsampling);
+    size_t frame_row_size = block_row_size(job->frame->stride, job->cb_subsampling, job->cr_subsampling);
+    uint32 block_rows = (rows + job->cr_subsampling - 1) / job->cr_subsampling;
+    const uint8* rows_start = job->image + (first_row / job->cr_subsampling) * frame_row_size;
+
+    *size = (tmsize_t) (block_rows * file_row_size);
+    *copy = NULL;
+    if (file_row_size == frame_row_size) {
+        return rows_start;
+    }
+
+    *copy = malloc(*size);
+    if (*copy == NULL) {
+        printf("[-] \033[0;31mCould not allocate a strip of %ld bytes\033[0m\n", (long) *size);
+        exit(EXIT_FAILURE);
+    }
+    for (uint32 block_row = 0; block_row < block_rows; ++block_row) {
+        memcpy(*copy + block_row * file_row_size, rows_start + block_row * frame_row_size, file_row_size);
+    }
+    return *copy;
+}
+
+
+static void encode_strip(const uint8* data, tmsize_t size, uint16 compression, encoded_strip_t* strip){
+    memory_file_t file = {NULL, 0, 0, 0};
+    TIFF* tiff_strip = TIFFClientOpen("strip", "w", (thandle_t) &file, memory_read, memory_write, memory_seek,
+                                      memory_close, memory_size, memory_map, memory_unmap);
+    if (tiff_strip == NULL) {
+        printf("[-] \033[0;31mCould not open a strip for compression\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the codecs only see a stream of bytes, a single 8-bit row of the strip size will do
+    TIFFSetField(tiff_strip, TIFFTAG_IMAGEWIDTH, (uint32) size);
+    TIFFSetField(tiff_strip, TIFFTAG_IMAGELENGTH, 1);
+    TIFFSetField(tiff_strip, TIFFTAG_ROWSPERSTRIP, 1);
+    TIFFSetField(tiff_strip, TIFFTAG_SAMPLESPERPIXEL, 1);
+    TIFFSetField(tiff_strip, TIFFTAG_BITSPERSAMPLE, 8);
+    TIFFSetField(tiff_strip, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    TIFFSetField(tiff_strip, TIFFTAG_COMPRESSION, compression);
+    if (TIFFWriteEncodedStrip(tiff_strip, 0, (void*) data, size) < 0) {
+        printf("[-] \033[0;31mCompressing strip failed!\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+
+    strip->size = (tmsize_t) TIFFGetStrileByteCount(tiff_strip, 0);
+    strip->data = malloc(strip->size);
+    if (strip->data == NULL) {
+        printf("[-] \033[0;31mCould not allocate a compressed strip\033[0m\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(strip->data, file.data + TIFFGetStrileOffset(tiff_strip, 0), strip->size);
+    TIFFClose(tiff_strip);
+    free(file.data);
+}
+
+
+// Thread pool band: every band is exactly one strip, rows_per_strip is even
+static void encode_strip_band(void* args, uint32 first_row, uint32 rows){
+    strip_job_t* job = (strip_job_t*) args;
+    uint8* copy;
+    tmsize_t size;
+
+    const uint8* data = strip_data(job, first_row, rows, &size, &copy);
+    encode_strip(data, size, job->compression, &job->strips[first_row / job->rows_per_strip]);
+    free(copy);
+}
+
+
+/**
+ * Creates filename.tiff for a YCbCr frame of the subsampling mode, tagged with its block size and chroma
+ * siting. rows_per_strip has to be even and a multiple of the block height, 0 picks strips of about
+ * TIFF_STRIP_SIZE bytes.
+ */
+TIFF* open_tiff_output(char* filename, const image_t* frame, subsampling_t subsampling, uint32 rows_per_strip){
+    const subsampling_mode_t* mode = &subsampling_modes[subsampling];
+    int cb_subsampling = mode->horizontal, cr_subsampling = mode->vertical;
+    // printf("[+] Creating output file \033[1;36m%s\033[0m\n", filename);
+    char* f = malloc(strlen(filename) + strlen(".tiff") + 1);
+    sprintf(f, "%s.tiff", filename);
+    TIFF* tiff_output = TIFFOpen(f, "w");
+    free(f);
+
+    if (!tiff_output){
+        printf("[-] \033[0;31mCould not create %s\033[0m\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    // whole sampling blocks and an even number of rows, so the thread pool can hand out one strip per band
+    if (rows_per_strip == 0) {
+        uint32 row_alignment = cr_subsampling > 2 ? cr_subsampling : 2;
+        rows_per_strip = (uint32) (TIFF_STRIP_SIZE / block_row_size(frame->width, cb_subsampling, cr_subsampling)) * cr_subsampling;
+        rows_per_strip = rows_per_strip < row_alignment ? row_alignment : rows_per_strip - rows_per_strip % row_alignment;
+    }
+
+    // matrix and range of the kernels' color space, readers assume BT.601 full range without them
+    static float studio_range[6] = {16, 235, 128, 240, 128, 240};
+    static float full_range[6] = {0, 255, 128, 255, 128, 255};
+    double kr, kb;
+    matrix_weights(color_space.matrix, &kr, &kb);
+    float coefficients[3] = {(float) kr, (float) (1 - kr - kb), (float) kb};
+
+    //printf("[o] Setting TIFF Tags\n");
+    TIFFSetField(tiff_output, TIFFTAG_IMAGEWIDTH, frame->width);
+    TIFFSetField(tiff_output, TIFFTAG_IMAGELENGTH, frame->height);
+    TIFFSetField(tiff_output, TIFFTAG_SAMPLESPERPIXEL, 3);
+    TIFFSetField(tiff_output, TIFFTAG_BITSPERSAMPLE, 8);
+    TIFFSetField(tiff_output, TIFFTAG_ORIENTATION, (int)ORIENTATION_BOTLEFT);
+    TIFFSetField(tiff_output, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tiff_output, TIFFTAG_COMPRESSION, output_compression);
+    TIFFSetField(tiff_output, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_YCBCR);
+    TIFFSetField(tiff_output, TIFFTAG_YCBCRSUBSAMPLING, cb_subsampling, cr_subsampling);
+    TIFFSetField(tiff_output, TIFFTAG_YCBCRPOSITIONING, mode->positioning);
+    TIFFSetField(tiff_output, TIFFTAG_YCBCRCOEFFICIENTS, coefficients);
+    TIFFSetField(tiff_output, TIFFTAG_REFERENCEBLACKWHITE, color_space.range == RANGE_STUDIO ? studio_range : full_range);
+    TIFFSetField(tiff_output, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
+    //printf("[+] \033[1;32mSuccessfully Set TIFF Tags\033[0m\n");
+
+    return tiff_output;
+}
+
+
+/**
+ * Writes image, rows [first_row, first_row + rows) of the frame, straight to the strips covering them. first_row has to
+ * start a strip and rows has to be a whole number of strips unless the range ends the image. Compressed
+ * strips are encoded in parallel on the default thread pool.
+ */
+void write_tiff_strips(TIFF* tiff_output, const uint8* image, const image_t* frame, uint32 first_row, uint32 rows, subsampling_t subsampling){
+    uint32 rows_per_strip = 0;
+    uint16 compression = COMPRESSION_NONE;
+    strip_job_t job = {tiff_output, image, frame, subsampling_modes[subsampling].horizontal, subsampling_modes[subsampling].vertical, 0, 0, NULL};
+
+    TIFFGetFieldDefaulted(tiff_output, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+    TIFFGetFieldDefaulted(tiff_output, TIFFTAG_COMPRESSION, &compression);
+    uint32 first_strip = first_row / rows_per_strip;
+    uint32 n_strips = (rows + rows_per_strip - 1) / rows_per_strip;
+    job.compression = compression;
+    job.rows_per_strip = rows_per_strip;
+
+    //printf("[o] Writing TIFF Image\n");
+    if (compression == COMPRESSION_NONE) {
+        for (uint32 strip = 0; strip < n_strips; ++strip) {
+            uint32 strip_row = strip * rows_per_strip;
+            uint32 strip_rows = (strip_row + rows_per_strip > rows) ? rows - strip_row : rows_per_strip;
+            uint8* copy;
+            tmsize_t size;
+            const uint8* data = strip_data(&job, strip_row, strip_rows, &size, &copy);
+
+            if (TIFFWriteRawStrip(tiff_output, first_strip + strip, (void*) data, size) < 0){
+                printf("[-] \033[0;31mWriting data failed!\033[0m\n");
+                exit(EXIT_FAILURE);
+            }
+            free(copy);
+        }
+        return;
+    }
+
+    job.strips = malloc(sizeof(encoded_strip_t) * n_strips);
+    if (job.strips == NULL) {
+        printf("[-] \033[0;31mCould not allocate %u compressed strips\033[0m\n", n_strips);
+        exit(EXIT_FAILURE);
+    }
+    thread_pool_run(thread_pool_default(), encode_strip_band, &job, rows, rows_per_strip);
+    for (uint32 strip = 0; strip < n_strips; ++strip) {
+        if (TIFFWriteRawStrip(tiff_output, first_strip + strip, job.strips[strip].data, job.strips[strip].size) < 0){
+            printf("[-] \033[0;31mWriting data failed!\033[0m\n");
+            exit(EXIT_FAILURE);
+        }
+        free(job.strips[strip].data);
+    }
+    free(job.strips);
+    //printf("[+] \033[1;32mSuccessfully Wrote TIFF Image\033[0m\n");
+}
+
+
+void write_tiff_image(uint8 *image, char* filename, const image_t* frame, subsampling_t subsampling) {
+    TIFF* tiff_output = open_tiff_output(filename, frame, subsampling, 0);
+    write_tiff_strips(tiff_output, image, frame, 0, frame->height, subsampling);
+    TIFFClose(tiff_output);
+}
+
+
+// Compression of every file created by open_tiff_output from now on
+void set_tiff_compression(uint16 compression){
+    output_compression = compression;
+}
+
+
+// Top-left RGBA TIFF of a raster, written a scanline at a time since the stride may pad the rows
+void write_tiff_rgb_image(const uint32* raster, char* filename, const image_t* image){
+    uint16 extra_samples[1] = {EXTRASAMPLE_UNASSALPHA};
+    char* f = malloc(strlen(filename) + strlen(".tiff") + 1);
+    sprintf(f, "%s.tiff", filename);
+    TIFF* tiff_output = TIFFOpen(f, "w");
+    free(f);
+
+    if (!tiff_output){
+        printf("[-] \033[0;31mCould not create %s\033[0m\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    TIFFSetField(tiff_output, TIFFTAG_IMAGEWIDTH, image->width);
+    TIFFSetField(tiff_output, TIFFTAG_IMAGELENGTH, image->height);
+    TIFFSetField(tiff_output, TIFFTAG_SAMPLESPERPIXEL, 4);
+    TIFFSetField(tiff_output, TIFFTAG_EXTRASAMPLES, 1, extra_samples);
+    TIFFSetField(tiff_output, TIFFTAG_BITSPERSAMPLE, 8);
+    TIFFSetField(tiff_output, TIFFTAG_ORIENTATION, (int)ORIENTATION_TOPLEFT);
+    TIFFSetField(tiff_output, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tiff_output, TIFFTAG_COMPRESSION, output_compression);
+    TIFFSetField(tiff_output, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+    TIFFSetField(tiff_output, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tiff_output, 0));
+
+    for (uint32 row = 0; row < image->height; ++row) {
+        if (TIFFWriteScanline(tiff_output, (void*) (raster + (size_t) row * image->stride), row, 0) < 0){
+            printf("[-] \033[0;31mWriting data failed!\033[0m\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    TIFFClose(tiff_output);
+}
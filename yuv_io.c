@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "conversion.h"
+
+
+// Writes `rows` rows of row_bytes bytes that lie stride bytes apart
+static void write_plane(FILE* file, const uint8* plane, size_t row_bytes, size_t stride, uint32 rows){
+    for (uint32 row = 0; row < rows; ++row) {
+        if (fwrite(plane + row * stride, 1, row_bytes, file) != row_bytes) {
+            printf("[-] \033[0;31mWriting data failed!\033[0m\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+
+/**
+ * Writes a PLANAR_FRAME_SIZE frame to filename.yuv as plain I420 or NV12, the layout ffmpeg and most
+ * encoders take with -pix_fmt yuv420p / nv12. The row padding of the stride is left out.
+ */
+void write_yuv_image(const uint8* frame, char* filename, const image_t* image, planar_layout_t layout){
+    planes_t planes = frame_planes((uint8*) frame, image, layout);
+    uint32 chroma_width = (image->width + 1) / 2;
+    uint32 chroma_rows = (image->height + 1) / 2;
+    char* f = malloc(strlen(filename) + strlen(".yuv") + 1);
+    sprintf(f, "%s.yuv", filename);
+    FILE* file = fopen(f, "wb");
+    free(f);
+
+    if (!file){
+        printf("[-] \033[0;31mCould not create %s\033[0m\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    write_plane(file, planes.y, image->width, image->stride, image->height);
+    if (layout == LAYOUT_I420) {
+        write_plane(file, planes.cb, chroma_width, CHROMA_STRIDE(image), chroma_rows);
+        write_plane(file, planes.cr, chroma_width, CHROMA_STRIDE(image), chroma_rows);
+    } else {
+        write_plane(file, planes.cb, chroma_width * 2, CHROMA_STRIDE(image) * 2, chroma_rows);
+    }
+    fclose(file);
+}